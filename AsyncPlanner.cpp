@@ -0,0 +1,100 @@
+#include "provided.h"
+#include "AsyncPlanner.h"
+#include "Executor.h"
+#include <future>
+#include <memory>
+#include <vector>
+using namespace std;
+
+class AsyncPlannerImpl
+{
+public:
+    AsyncPlannerImpl(const StreetMap* sm, int numWorkers);
+    ~AsyncPlannerImpl();
+    future<RouteOutcome> generatePointToPointRoute(const GeoCoord& start, const GeoCoord& end, CancellationToken cancel);
+    future<PlanOutcome> generateDeliveryPlan(const GeoCoord& depot, vector<DeliveryRequest> deliveries, CancellationToken cancel);
+private:
+	PointToPointRouter* m_router;
+	DeliveryPlanner* m_planner;
+	Executor* m_executor;
+};
+
+AsyncPlannerImpl::AsyncPlannerImpl(const StreetMap* sm, int numWorkers)
+{
+	m_router = new PointToPointRouter(sm);
+	m_planner = new DeliveryPlanner(sm);
+	m_executor = new Executor(numWorkers);
+}
+
+AsyncPlannerImpl::~AsyncPlannerImpl()
+{
+	delete m_executor;	//first, so no task is still using the router or planner
+	delete m_planner;
+	delete m_router;
+}
+
+future<RouteOutcome> AsyncPlannerImpl::generatePointToPointRoute(const GeoCoord& start, const GeoCoord& end, CancellationToken cancel)
+{
+	//the promise is shared because a std::function has to be copyable
+	shared_ptr<promise<RouteOutcome>> outcome = make_shared<promise<RouteOutcome>>();
+	const PointToPointRouter* router = m_router;
+	m_executor->submit([router, start, end, cancel, outcome]()
+	{
+		RouteOutcome result;
+		result.totalDistanceTravelled = 0;
+		if (cancel.cancelled())
+			result.result = CANCELLED;
+		else
+			result.result = router->generatePointToPointRoute(start, end, result.route, result.totalDistanceTravelled, cancel);
+		outcome->set_value(std::move(result));
+	});
+	return outcome->get_future();
+}
+
+future<PlanOutcome> AsyncPlannerImpl::generateDeliveryPlan(const GeoCoord& depot, vector<DeliveryRequest> deliveries, CancellationToken cancel)
+{
+	shared_ptr<promise<PlanOutcome>> outcome = make_shared<promise<PlanOutcome>>();
+	shared_ptr<vector<DeliveryRequest>> stops = make_shared<vector<DeliveryRequest>>(std::move(deliveries));
+	const DeliveryPlanner* planner = m_planner;
+	m_executor->submit([planner, depot, stops, cancel, outcome]()
+	{
+		PlanOutcome result;
+		result.totalDistanceTravelled = 0;
+		if (cancel.cancelled())
+			result.result = CANCELLED;
+		else
+			result.result = planner->generateDeliveryPlan(depot, *stops, result.commands, result.totalDistanceTravelled, cancel);
+		outcome->set_value(std::move(result));
+	});
+	return outcome->get_future();
+}
+
+//******************** AsyncPlanner functions *********************************
+
+// These functions simply delegate to AsyncPlannerImpl's functions.
+
+AsyncPlanner::AsyncPlanner(const StreetMap* sm, int numWorkers)
+{
+    m_impl = new AsyncPlannerImpl(sm, numWorkers);
+}
+
+AsyncPlanner::~AsyncPlanner()
+{
+    delete m_impl;
+}
+
+future<RouteOutcome> AsyncPlanner::generatePointToPointRoute(
+    const GeoCoord& start,
+    const GeoCoord& end,
+    CancellationToken cancel) const
+{
+    return m_impl->generatePointToPointRoute(start, end, cancel);
+}
+
+future<PlanOutcome> AsyncPlanner::generateDeliveryPlan(
+    const GeoCoord& depot,
+    vector<DeliveryRequest> deliveries,
+    CancellationToken cancel) const
+{
+    return m_impl->generateDeliveryPlan(depot, std::move(deliveries), cancel);
+}
@@ -0,0 +1,53 @@
+// AsyncPlanner.h
+
+// Routes and plans that run in the background on one pool of worker threads, so a
+// caller can hand off many requests, keep working, and give up on any of them.  Each
+// call returns a future for its outcome at once.  Cancelling the token passed in stops
+// the search or the ordering at its next check and the future gets CANCELLED; a
+// request cancelled before a worker picks it up is answered without running at all.
+#ifndef ASYNCPLANNER_INCLUDED
+#define ASYNCPLANNER_INCLUDED
+
+#include <future>
+#include <list>
+#include <vector>
+#include "provided.h"
+
+struct RouteOutcome
+{
+    DeliveryResult result;
+    std::list<StreetSegment> route;
+    double totalDistanceTravelled;
+};
+
+struct PlanOutcome
+{
+    DeliveryResult result;
+    std::vector<DeliveryCommand> commands;
+    double totalDistanceTravelled;
+};
+
+class AsyncPlannerImpl;
+
+class AsyncPlanner
+{
+public:
+      // numWorkers threads shared by routes and plans; 0 uses one per core
+    AsyncPlanner(const StreetMap* sm, int numWorkers = 0);
+      // finishes everything already submitted; cancel what isn't wanted first
+    ~AsyncPlanner();
+    std::future<RouteOutcome> generatePointToPointRoute(
+        const GeoCoord& start,
+        const GeoCoord& end,
+        CancellationToken cancel = CancellationToken()) const;
+    std::future<PlanOutcome> generateDeliveryPlan(
+        const GeoCoord& depot,
+        std::vector<DeliveryRequest> deliveries,
+        CancellationToken cancel = CancellationToken()) const;
+    AsyncPlanner(const AsyncPlanner&) = delete;
+    AsyncPlanner& operator=(const AsyncPlanner&) = delete;
+private:
+    AsyncPlannerImpl* m_impl;
+};
+
+#endif // ASYNCPLANNER_INCLUDED
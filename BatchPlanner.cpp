@@ -0,0 +1,165 @@
+#include "provided.h"
+#include "BatchPlanner.h"
+#include "PlanBuilder.h"
+#include "RouteSearch.h"
+#include "MapSnapshot.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <memory_resource>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+class BatchPlannerImpl
+{
+public:
+    BatchPlannerImpl(const StreetMap* sm, int numWorkers);
+    ~BatchPlannerImpl();
+    void generateDeliveryPlans(const vector<BatchJob>& jobs, vector<BatchJobResult>& results) const;
+private:
+	const StreetMap* m_streetMap;
+	DeliveryOptimizer* m_optimizer;
+	int m_numWorkers;
+};
+
+//every leg leaving one node, routed by a single search
+struct LegsFrom
+{
+	int start;
+	vector<int> ends;
+	vector<EdgeRoute> routes;
+	vector<double> distances;
+	vector<DeliveryResult> results;
+};
+
+BatchPlannerImpl::BatchPlannerImpl(const StreetMap* sm, int numWorkers)
+{
+	m_streetMap = sm;
+	m_optimizer = new DeliveryOptimizer(sm);
+	m_numWorkers = numWorkers;
+}
+
+BatchPlannerImpl::~BatchPlannerImpl()
+{
+	delete m_optimizer;
+}
+
+void BatchPlannerImpl::generateDeliveryPlans(const vector<BatchJob>& jobs, vector<BatchJobResult>& results) const
+{
+	results.assign(jobs.size(), BatchJobResult());
+	for (int j = 0; j < jobs.size(); j++)
+	{
+		results[j].status = BAD_COORD;
+		results[j].totalDistanceTravelled = 0;
+	}
+	//the whole batch is planned against one version of the map
+	shared_ptr<const MapSnapshot> map = m_streetMap->getSnapshot();
+	if (map == nullptr)
+		return;
+	const StreetGraph& graph = *map->graph;
+
+	//check and order every job; each task only touches its own job's entries
+	vector<vector<DeliveryRequest>> ordered(jobs.size());
+	parallelFor(jobs.size(), [&](int j)
+	{
+		results[j].status = validateDeliveries(graph, jobs[j].depot, jobs[j].deliveries);
+		if (results[j].status != DELIVERY_SUCCESS)
+			return;
+		ordered[j] = jobs[j].deliveries;
+		double oldDist = 0;
+		double newDist = 0;
+		m_optimizer->optimizeDeliveryOrder(jobs[j].depot, ordered[j], oldDist, newDist);
+	}, m_numWorkers);
+
+	//turn every coord into its node once, and gather the distinct legs by where they start
+	vector<LegsFrom> searches;
+	unordered_map<int, int> searchFrom;	//start node : its entry in searches
+	unordered_map<long long, pair<int, int>> legIndex;	//(start, end) : search, destination
+	vector<vector<int>> stops(jobs.size());	//job : depot node, stop nodes..., depot node
+	for (int j = 0; j < jobs.size(); j++)
+	{
+		if (results[j].status != DELIVERY_SUCCESS)
+			continue;
+		int depot = graph.findNode(jobs[j].depot);
+		stops[j].push_back(depot);
+		for (int i = 0; i < ordered[j].size(); i++)
+			stops[j].push_back(graph.findNode(ordered[j][i].location));
+		stops[j].push_back(depot);
+		for (int i = 0; i + 1 < stops[j].size(); i++)
+		{
+			int from = stops[j][i];
+			int to = stops[j][i + 1];
+			long long key = (long long)from * graph.nodeCount() + to;
+			if (legIndex.count(key) != 0)
+				continue;
+			auto found = searchFrom.find(from);
+			if (found == searchFrom.end())
+			{
+				found = searchFrom.insert(make_pair(from, (int)searches.size())).first;
+				searches.push_back(LegsFrom());
+				searches.back().start = from;
+			}
+			legIndex[key] = make_pair(found->second, (int)searches[found->second].ends.size());
+			searches[found->second].ends.push_back(to);
+		}
+	}
+
+	//one search per distinct start; each worker sizes a scratch to the graph once and
+	//reuses it for every search it takes, as many batches have far more starts than workers
+	int numWorkers = workerCount(searches.size(), m_numWorkers);
+	atomic<int> nextSearch(0);
+	parallelFor(numWorkers, [&](int)
+	{
+		pmr::monotonic_buffer_resource arena;
+		RouteScratch scratch(graph, &arena);
+		for (int s = nextSearch++; s < searches.size(); s = nextSearch++)
+		{
+			LegsFrom& legs = searches[s];
+			searchRoutesFrom(*map, legs.start, legs.ends, legs.routes, legs.distances, legs.results, scratch);
+		}
+	}, numWorkers);
+
+	//describe every job from the shared routes
+	parallelFor(jobs.size(), [&](int j)
+	{
+		if (results[j].status != DELIVERY_SUCCESS)
+			return;
+		CommandListSink sink(results[j].commands);
+		for (int i = 0; i + 1 < stops[j].size(); i++)
+		{
+			long long key = (long long)stops[j][i] * graph.nodeCount() + stops[j][i + 1];
+			const pair<int, int>& leg = legIndex.find(key)->second;
+			const LegsFrom& legs = searches[leg.first];
+			if (legs.results[leg.second] != DELIVERY_SUCCESS)
+			{
+				results[j].status = legs.results[leg.second];
+				results[j].commands.clear();
+				results[j].totalDistanceTravelled = 0;
+				return;
+			}
+			results[j].totalDistanceTravelled += legs.distances[leg.second];
+			describeLeg(graph, legs.routes[leg.second], i < ordered[j].size() ? &ordered[j][i] : nullptr, sink);
+		}
+	}, m_numWorkers);
+}
+
+//******************** BatchPlanner functions *********************************
+
+// These functions simply delegate to BatchPlannerImpl's functions.
+
+BatchPlanner::BatchPlanner(const StreetMap* sm, int numWorkers)
+{
+    m_impl = new BatchPlannerImpl(sm, numWorkers);
+}
+
+BatchPlanner::~BatchPlanner()
+{
+    delete m_impl;
+}
+
+void BatchPlanner::generateDeliveryPlans(const vector<BatchJob>& jobs, vector<BatchJobResult>& results) const
+{
+    m_impl->generateDeliveryPlans(jobs, results);
+}
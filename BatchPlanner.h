@@ -0,0 +1,46 @@
+// BatchPlanner.h
+
+// Plans many delivery manifests against one map in a single call.  Every job's stops are
+// put in order first; then each distinct leg across all of the jobs is routed only once,
+// with one search per distinct starting point serving every leg that leaves it, so a
+// shared depot or an address that shows up in many manifests costs one search instead
+// of one per appearance.  Searches, ordering and rendering are spread over a pool of
+// worker threads.
+#ifndef BATCHPLANNER_INCLUDED
+#define BATCHPLANNER_INCLUDED
+
+#include <vector>
+#include "provided.h"
+
+struct BatchJob
+{
+    GeoCoord depot;
+    std::vector<DeliveryRequest> deliveries;
+};
+
+  // What DeliveryPlanner::generateDeliveryPlan would have returned for one job
+struct BatchJobResult
+{
+    DeliveryResult status;
+    std::vector<DeliveryCommand> commands;
+    double totalDistanceTravelled;
+};
+
+class BatchPlannerImpl;
+
+class BatchPlanner
+{
+public:
+      // numWorkers threads at most; 0 uses one per core
+    BatchPlanner(const StreetMap* sm, int numWorkers = 0);
+    ~BatchPlanner();
+      // results gets one entry per job, in the same order as jobs.  Among routes of the
+      // same length a batch may pick a different one than a single plan would.
+    void generateDeliveryPlans(const std::vector<BatchJob>& jobs, std::vector<BatchJobResult>& results) const;
+    BatchPlanner(const BatchPlanner&) = delete;
+    BatchPlanner& operator=(const BatchPlanner&) = delete;
+private:
+    BatchPlannerImpl* m_impl;
+};
+
+#endif // BATCHPLANNER_INCLUDED
@@ -0,0 +1,67 @@
+// ByteBuffer.h
+
+// Little helpers for the binary files: values are stored in the machine's own byte
+// order, and strings as a length followed by their bytes.
+#ifndef BYTEBUFFER_INCLUDED
+#define BYTEBUFFER_INCLUDED
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+  // appends fixed size values and strings to a byte buffer
+class ByteWriter
+{
+public:
+	template<typename T>
+	void put(T value) { m_bytes.append(reinterpret_cast<const char*>(&value), sizeof(value)); }
+	  // a short text takes a one byte length and must be under 256 bytes
+	void putText(const std::string& text, bool longText)
+	{
+		if (longText)
+			put<uint32_t>(text.size());
+		else
+			put<uint8_t>(text.size());
+		m_bytes += text;
+	}
+	const std::string& bytes() const { return m_bytes; }
+	void clear() { m_bytes.clear(); }
+private:
+	std::string m_bytes;
+};
+
+  // reads back what ByteWriter wrote; every get fails once the buffer runs out
+class ByteReader
+{
+public:
+	ByteReader(const std::string& bytes) : m_bytes(bytes), m_next(0) {}
+	template<typename T>
+	bool get(T& value)
+	{
+		if (m_next + sizeof(value) > m_bytes.size())
+			return false;
+		std::memcpy(&value, m_bytes.data() + m_next, sizeof(value));
+		m_next += sizeof(value);
+		return true;
+	}
+	bool getText(std::string& text, bool longText)
+	{
+		uint32_t length = 0;
+		uint8_t shortLength = 0;
+		if (longText ? !get(length) : !get(shortLength))
+			return false;
+		if (!longText)
+			length = shortLength;
+		if (m_next + length > m_bytes.size())
+			return false;
+		text.assign(m_bytes, m_next, length);
+		m_next += length;
+		return true;
+	}
+	bool atEnd() const { return m_next == m_bytes.size(); }
+private:
+	const std::string& m_bytes;
+	size_t m_next;
+};
+
+#endif // BYTEBUFFER_INCLUDED
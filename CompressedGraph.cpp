@@ -0,0 +1,178 @@
+#include "provided.h"
+#include "CompressedGraph.h"
+#include "StreetGraph.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+using namespace std;
+
+//digits kept after the decimal point, matching FIXED_POINT_SCALE
+const int FIXED_POINT_DIGITS = 7;
+
+//a coordinate's text as a whole number of 1e-7 degrees, and how many decimal places the
+//text has; false if it has more than that or isn't a plain decimal number
+bool toFixedPoint(const string& text, int32_t& value, int& decimals)
+{
+	size_t i = 0;
+	bool negative = i < text.size() && text[i] == '-';
+	if (negative)
+		i++;
+	long long whole = 0;
+	int digits = 0;
+	for (; i < text.size() && isdigit((unsigned char)text[i]); i++, digits++)
+		whole = whole * 10 + (text[i] - '0');
+	decimals = 0;
+	if (i < text.size() && text[i] == '.')
+	{
+		for (i++; i < text.size() && isdigit((unsigned char)text[i]); i++, decimals++)
+		{
+			if (decimals == FIXED_POINT_DIGITS)
+				return false;
+			whole = whole * 10 + (text[i] - '0');
+		}
+	}
+	if (i != text.size() || digits == 0 || digits > 3)
+		return false;
+	for (int scaled = decimals; scaled < FIXED_POINT_DIGITS; scaled++)
+		whole *= 10;
+	value = negative ? -whole : whole;
+	return true;
+}
+
+//the coordinate written with the given number of decimal places
+string fromFixedPoint(int32_t value, int decimals)
+{
+	string text = value < 0 ? "-" : "";
+	long long magnitude = abs((long long)value);
+	text += to_string(magnitude / 10000000);
+	if (decimals > 0)
+	{
+		string fraction = to_string(magnitude % 10000000);
+		fraction = string(FIXED_POINT_DIGITS - fraction.size(), '0') + fraction;
+		text += "." + fraction.substr(0, decimals);
+	}
+	return text;
+}
+
+CompressedGraph::CompressedGraph()
+{
+}
+
+bool CompressedGraph::build(const StreetGraph& graph)
+{
+	int numNodes = graph.nodeCount();
+	vector<int32_t> latitudes(numNodes);
+	vector<int32_t> longitudes(numNodes);
+	vector<uint8_t> decimals(numNodes);
+	for (int i = 0; i < numNodes; i++)
+	{
+		const GeoCoord& gc = graph.coord(i);
+		int latDecimals = 0;
+		int lonDecimals = 0;
+		if (!toFixedPoint(gc.latitudeText, latitudes[i], latDecimals) || !toFixedPoint(gc.longitudeText, longitudes[i], lonDecimals)
+			|| fromFixedPoint(latitudes[i], latDecimals) != gc.latitudeText
+			|| fromFixedPoint(longitudes[i], lonDecimals) != gc.longitudeText)
+			return false;
+		decimals[i] = latDecimals | lonDecimals << 4;
+	}
+
+	//two texts for the same place ("34.05" and "34.050") are different nodes to a StreetGraph
+	vector<int32_t> byPosition(numNodes);
+	for (int i = 0; i < numNodes; i++)
+		byPosition[i] = i;
+	sort(byPosition.begin(), byPosition.end(), [&](int a, int b)
+	{
+		return make_pair(latitudes[a], longitudes[a]) < make_pair(latitudes[b], longitudes[b]);
+	});
+	for (int i = 0; i + 1 < numNodes; i++)
+		if (latitudes[byPosition[i]] == latitudes[byPosition[i + 1]] && longitudes[byPosition[i]] == longitudes[byPosition[i + 1]])
+			return false;
+	m_latitudes.swap(latitudes);
+	m_longitudes.swap(longitudes);
+	m_decimals.swap(decimals);
+	m_byPosition.swap(byPosition);
+
+	m_components.resize(numNodes);
+	m_firstEdge.resize(numNodes + 1);
+	m_firstByte.resize(numNodes + 1);
+	m_bytes.clear();
+	for (int i = 0; i < numNodes; i++)
+	{
+		m_components[i] = graph.component(i);
+		m_firstEdge[i] = graph.firstEdge(i);
+		m_firstByte[i] = m_bytes.size();
+		for (int e = graph.firstEdge(i); e < graph.firstEdge(i + 1); e++)
+		{
+			int32_t delta = graph.edgeTarget(e) - i;
+			writeVarint(((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31));
+			writeVarint((uint32_t)ceil(graph.edgeLength(e) / LENGTH_UNIT));	//rounded up so no edge looks cheaper than it is
+			writeVarint(graph.edgeNameId(e));
+		}
+	}
+	m_firstEdge[numNodes] = graph.firstEdge(numNodes);
+	m_firstByte[numNodes] = m_bytes.size();
+	m_bytes.shrink_to_fit();
+
+	m_names.resize(graph.nameCount());
+	for (int n = 0; n < graph.nameCount(); n++)
+		m_names[n] = graph.name(n);
+
+	return true;
+}
+
+bool CompressedGraph::load(string mapFile)
+{
+	StreetGraph graph;
+	if (!graph.load(mapFile, HILBERT_ORDER))	//nearby nodes get nearby numbers, so the deltas stay small
+		return false;
+	return build(graph);
+}
+
+int CompressedGraph::findNode(const GeoCoord& gc) const
+{
+	int32_t lat = 0;
+	int32_t lon = 0;
+	int latDecimals = 0;
+	int lonDecimals = 0;
+	if (!toFixedPoint(gc.latitudeText, lat, latDecimals) || !toFixedPoint(gc.longitudeText, lon, lonDecimals))
+		return -1;
+	auto found = lower_bound(m_byPosition.begin(), m_byPosition.end(), make_pair(lat, lon), [this](int node, const pair<int32_t, int32_t>& position)
+	{
+		return make_pair(m_latitudes[node], m_longitudes[node]) < position;
+	});
+	if (found == m_byPosition.end() || m_latitudes[*found] != lat || m_longitudes[*found] != lon)
+		return -1;
+	//the same place written another way isn't the map's coord, as with StreetGraph
+	if (coord(*found) != gc)
+		return -1;
+	return *found;
+}
+
+GeoCoord CompressedGraph::coord(int node) const
+{
+	return GeoCoord(fromFixedPoint(m_latitudes[node], m_decimals[node] & 0xf), fromFixedPoint(m_longitudes[node], m_decimals[node] >> 4));
+}
+
+size_t CompressedGraph::bytes() const
+{
+	size_t total = (m_latitudes.capacity() + m_longitudes.capacity() + m_components.capacity()
+		+ m_firstEdge.capacity() + m_byPosition.capacity()) * sizeof(int32_t);
+	total += m_firstByte.capacity() * sizeof(uint32_t) + m_bytes.capacity() + m_decimals.capacity();
+	for (int i = 0; i < m_names.size(); i++)
+		total += sizeof(string) + (m_names[i].capacity() > 15 ? m_names[i].capacity() + 1 : 0);
+	return total;
+}
+
+void CompressedGraph::writeVarint(uint32_t value)
+{
+	while (value >= 0x80)
+	{
+		m_bytes.push_back((value & 0x7f) | 0x80);
+		value >>= 7;
+	}
+	m_bytes.push_back(value);
+}
@@ -0,0 +1,103 @@
+// CompressedGraph.h
+
+// A StreetGraph packed into far fewer bytes, for regions too big to hold as flat arrays.
+// Coordinates are kept as fixed point integers in units of 1e-7 degrees, the precision
+// the map files are written in, with how many decimal places each was written with, so
+// its text comes back exactly as the map file had it.  Each node's edges are one run of
+// bytes, in the same order as the StreetGraph: for every edge, the distance from the
+// node's number to the target's (zigzag varint, small because nodes are numbered along a
+// Hilbert curve), the length rounded up to a whole number of LENGTH_UNIT miles (varint),
+// and the street name (varint).  Rounding lengths up keeps the straight line estimate of
+// a search from ever exceeding a route's cost, and routes report distances worked out
+// from the exact coordinates, so only which of two nearly equal routes a search picks
+// can change.
+//
+// Edges keep the numbers they had in the StreetGraph the graph was built from.
+#ifndef COMPRESSEDGRAPH_INCLUDED
+#define COMPRESSEDGRAPH_INCLUDED
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "provided.h"
+
+class StreetGraph;
+
+class CompressedGraph
+{
+public:
+	  // edge lengths are stored in whole numbers of this many miles
+	static constexpr double LENGTH_UNIT = 1e-5;
+
+	CompressedGraph();
+	  // false if some coord has more than 7 decimal places, isn't plainly written (a
+	  // leading "+" or zero, say) so its text could not be given back exactly, or is the
+	  // same place as another coord written differently
+	bool build(const StreetGraph& graph);
+	  // load a map data file and compress it; the uncompressed graph is thrown away
+	bool load(std::string mapFile);
+
+	int nodeCount() const { return m_latitudes.size(); }
+	int edgeCount() const { return m_firstEdge.empty() ? 0 : m_firstEdge.back(); }
+	  // returns -1 if the coord is not on the map; as with StreetGraph its text must be the
+	  // map's, so "34.050" doesn't find "34.05"
+	int findNode(const GeoCoord& gc) const;
+	GeoCoord coord(int node) const;
+	double latitude(int node) const { return m_latitudes[node] / FIXED_POINT_SCALE; }
+	double longitude(int node) const { return m_longitudes[node] / FIXED_POINT_SCALE; }
+	int component(int node) const { return m_components[node]; }
+	int firstEdge(int node) const { return m_firstEdge[node]; }
+	const std::string& name(int nameId) const { return m_names[nameId]; }
+
+	  // calls visit(edge, target, length, nameId) for every edge leaving node, in order
+	template<typename Visitor>
+	void forEachEdge(int node, Visitor visit) const
+	{
+		const uint8_t* next = m_bytes.data() + m_firstByte[node];
+		for (int edge = m_firstEdge[node]; edge < m_firstEdge[node + 1]; edge++)
+		{
+			uint32_t zigzag = readVarint(next);
+			int target = node + (int)((zigzag >> 1) ^ -(int32_t)(zigzag & 1));
+			double length = readVarint(next) * LENGTH_UNIT;
+			int nameId = readVarint(next);
+			visit(edge, target, length, nameId);
+		}
+	}
+
+	  // memory held by the graph, in bytes
+	size_t bytes() const;
+
+	CompressedGraph(const CompressedGraph&) = delete;
+	CompressedGraph& operator=(const CompressedGraph&) = delete;
+
+private:
+	static constexpr double FIXED_POINT_SCALE = 1e7;
+
+	std::vector<int32_t> m_latitudes;
+	std::vector<int32_t> m_longitudes;
+	  // decimal places in each node's latitude text (low four bits) and longitude text
+	std::vector<uint8_t> m_decimals;
+	std::vector<int32_t> m_components;
+	std::vector<int32_t> m_firstEdge;
+	  // where each node's edges start in m_bytes, with one more for the end of the last
+	std::vector<uint32_t> m_firstByte;
+	std::vector<uint8_t> m_bytes;
+	std::vector<std::string> m_names;
+	  // node numbers sorted by (latitude, longitude), for finding a coord's node
+	std::vector<int32_t> m_byPosition;
+
+	static uint32_t readVarint(const uint8_t*& next)
+	{
+		uint32_t value = *next & 0x7f;
+		int shift = 7;
+		while (*next++ & 0x80)
+		{
+			value |= (uint32_t)(*next & 0x7f) << shift;
+			shift += 7;
+		}
+		return value;
+	}
+	void writeVarint(uint32_t value);
+};
+
+#endif // COMPRESSEDGRAPH_INCLUDED
@@ -0,0 +1,204 @@
+// ConcurrentHashMap.h
+
+// A sibling of ExpandableHashMap that any number of threads can use at once, for caches
+// and lookup tables shared between workers.  Keys are hashed with the same hasher()
+// functions, and associate() behaves the same way.  find() copies the value out instead
+// of returning a pointer, since another thread may replace the value or move it at any
+// moment.
+//
+// The map is split into segments by hash, each with its own reader/writer lock, so
+// lookups in a segment share it and only writers to the same segment wait for each
+// other.  A segment that passes the maximum load factor doesn't rehash all at once: it
+// starts a table twice the size, and every later write to the segment moves a couple of
+// buckets across while lookups check whichever table still holds their bucket.  No write
+// ever waits for more than a few buckets to move, and the other segments aren't
+// involved at all.
+#ifndef CONCURRENTHASHMAP_INCLUDED
+#define CONCURRENTHASHMAP_INCLUDED
+
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <utility>
+#include <vector>
+
+template<typename KeyType, typename ValueType>
+class ConcurrentHashMap
+{
+public:
+	ConcurrentHashMap(double maximumLoadFactor = 0.5);
+	  // not safe to call while other threads use the map
+	void reset();
+	int size() const { return m_numItems.load(std::memory_order_relaxed); }
+	void associate(const KeyType& key, const ValueType& value);
+	  // copies the value for key into value; returns false, leaving value alone, if key
+	  // isn't in the map
+	bool find(const KeyType& key, ValueType& value) const;
+	  // takes key and its value out of the map; returns false if key isn't in the map
+	bool remove(const KeyType& key);
+
+	ConcurrentHashMap(const ConcurrentHashMap&) = delete;
+	ConcurrentHashMap& operator=(const ConcurrentHashMap&) = delete;
+
+private:
+	static const int NUM_SEGMENTS = 64;
+	static const int INITIAL_BUCKETS = 8;
+	//old buckets each write moves into the new table while a segment is growing
+	static const int BUCKETS_MOVED_PER_WRITE = 2;
+
+	typedef std::vector<std::pair<KeyType, ValueType>> Bucket;
+
+	struct Segment
+	{
+		mutable std::shared_mutex mutex;
+		std::vector<Bucket> table;
+		//the table being drained while the segment grows; empty otherwise
+		std::vector<Bucket> oldTable;
+		//buckets of oldTable before this one have been moved
+		size_t nextToMove = 0;
+		int numItems = 0;
+	};
+
+	std::vector<Segment> m_segments;
+	double m_maxLoadFactor;
+	std::atomic<int> m_numItems;
+
+	static unsigned int hashOf(const KeyType& key)
+	{
+		unsigned int hasher(const KeyType& k);
+		return hasher(key);
+	}
+	  // the bucket key would be in if it's in the segment, from whichever table holds it
+	static const Bucket& bucketFor(const Segment& segment, unsigned int hash);
+	static void moveBuckets(Segment& segment, int count);
+};
+
+template <typename KeyType, typename ValueType>
+ConcurrentHashMap<KeyType, ValueType>::ConcurrentHashMap(double maximumLoadFactor)
+	: m_segments(NUM_SEGMENTS), m_maxLoadFactor(maximumLoadFactor), m_numItems(0)
+{
+	for (int i = 0; i < NUM_SEGMENTS; i++)
+		m_segments[i].table.resize(INITIAL_BUCKETS);
+}
+
+template <typename KeyType, typename ValueType>
+void ConcurrentHashMap<KeyType, ValueType>::reset()
+{
+	for (int i = 0; i < NUM_SEGMENTS; i++)
+	{
+		Segment& segment = m_segments[i];
+		segment.table.assign(INITIAL_BUCKETS, Bucket());
+		segment.oldTable.clear();
+		segment.nextToMove = 0;
+		segment.numItems = 0;
+	}
+	m_numItems = 0;
+}
+
+template <typename KeyType, typename ValueType>
+const typename ConcurrentHashMap<KeyType, ValueType>::Bucket& ConcurrentHashMap<KeyType, ValueType>::bucketFor(
+	const Segment& segment, unsigned int hash)
+{
+	unsigned int segmentHash = hash / NUM_SEGMENTS;	//the low bits already picked the segment
+	if (!segment.oldTable.empty())
+	{
+		size_t oldBucket = segmentHash % segment.oldTable.size();
+		if (oldBucket >= segment.nextToMove)	//not moved yet
+			return segment.oldTable[oldBucket];
+	}
+	return segment.table[segmentHash % segment.table.size()];
+}
+
+template <typename KeyType, typename ValueType>
+void ConcurrentHashMap<KeyType, ValueType>::moveBuckets(Segment& segment, int count)
+{
+	for (int i = 0; i < count && !segment.oldTable.empty(); i++)
+	{
+		Bucket& from = segment.oldTable[segment.nextToMove];
+		for (size_t j = 0; j < from.size(); j++)
+		{
+			unsigned int segmentHash = hashOf(from[j].first) / NUM_SEGMENTS;
+			segment.table[segmentHash % segment.table.size()].push_back(std::move(from[j]));
+		}
+		Bucket().swap(from);
+		segment.nextToMove++;
+		if (segment.nextToMove == segment.oldTable.size())	//every bucket has moved
+		{
+			std::vector<Bucket>().swap(segment.oldTable);
+			segment.nextToMove = 0;
+		}
+	}
+}
+
+template <typename KeyType, typename ValueType>
+void ConcurrentHashMap<KeyType, ValueType>::associate(const KeyType& key, const ValueType& value)
+{
+	unsigned int hash = hashOf(key);
+	Segment& segment = m_segments[hash % NUM_SEGMENTS];
+	std::unique_lock<std::shared_mutex> lock(segment.mutex);
+	moveBuckets(segment, BUCKETS_MOVED_PER_WRITE);
+
+	Bucket& bucket = const_cast<Bucket&>(bucketFor(segment, hash));
+	for (size_t i = 0; i < bucket.size(); i++)
+	{
+		if (bucket[i].first == key)	//replace value if key is already in map
+		{
+			bucket[i].second = value;
+			return;
+		}
+	}
+	bucket.push_back(std::make_pair(key, value));
+	segment.numItems++;
+	m_numItems.fetch_add(1, std::memory_order_relaxed);
+
+	if (segment.numItems > m_maxLoadFactor * segment.table.size())
+	{
+		if (!segment.oldTable.empty())	//outgrew the new table before the last grow finished
+			moveBuckets(segment, segment.oldTable.size());
+		segment.oldTable.swap(segment.table);
+		segment.table.assign(segment.oldTable.size() * 2, Bucket());
+		segment.nextToMove = 0;
+	}
+}
+
+template <typename KeyType, typename ValueType>
+bool ConcurrentHashMap<KeyType, ValueType>::find(const KeyType& key, ValueType& value) const
+{
+	unsigned int hash = hashOf(key);
+	const Segment& segment = m_segments[hash % NUM_SEGMENTS];
+	std::shared_lock<std::shared_mutex> lock(segment.mutex);
+	const Bucket& bucket = bucketFor(segment, hash);
+	for (size_t i = 0; i < bucket.size(); i++)
+	{
+		if (bucket[i].first == key)
+		{
+			value = bucket[i].second;
+			return true;
+		}
+	}
+	return false;
+}
+
+template <typename KeyType, typename ValueType>
+bool ConcurrentHashMap<KeyType, ValueType>::remove(const KeyType& key)
+{
+	unsigned int hash = hashOf(key);
+	Segment& segment = m_segments[hash % NUM_SEGMENTS];
+	std::unique_lock<std::shared_mutex> lock(segment.mutex);
+	moveBuckets(segment, BUCKETS_MOVED_PER_WRITE);
+
+	Bucket& bucket = const_cast<Bucket&>(bucketFor(segment, hash));
+	for (size_t i = 0; i < bucket.size(); i++)
+	{
+		if (bucket[i].first == key)
+		{
+			bucket.erase(bucket.begin() + i);
+			segment.numItems--;
+			m_numItems.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+	return false;
+}
+
+#endif // CONCURRENTHASHMAP_INCLUDED
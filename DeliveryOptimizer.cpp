@@ -1,9 +1,24 @@
 #include "provided.h"
+#include "HilbertCurve.h"
+#include "Parallel.h"
+#include <algorithm>
 #include <vector>
+#include <memory_resource>
 using namespace std;
 
+//manifests with more stops than this skip annealing and use the large instance pipeline
+const int LARGE_INSTANCE_STOPS = 150;
+//stops in each cluster of the large instance pipeline
+const int CLUSTER_STOPS = 64;
+//2-opt and relocate passes over one cluster stop after this many even if still improving
+const int MAX_PATH_PASSES = 50;
+//annealing starts at this temperature and cools by this fraction each step until it reaches 1
+const double START_TEMPERATURE = 10000;
+const double COOLING_RATE = 0.003;
+
 
 double getDistance(const vector<DeliveryRequest>& deliveries, const GeoCoord& depot);
+double getDistance(const vector<DeliveryRequest>& deliveries, const pmr::vector<int>& order, const GeoCoord& depot);
 
 class DeliveryOptimizerImpl
 {
@@ -14,11 +29,28 @@ public:
         const GeoCoord& depot,
         vector<DeliveryRequest>& deliveries,
         double& oldCrowDistance,
-        double& newCrowDistance) const;
+        double& newCrowDistance,
+        const CancellationToken* cancel) const;
 	double acceptChance(double distance, double newDistance, double temp) const;
-
+private:
+	void optimizeLargeInstance(const GeoCoord& depot, vector<DeliveryRequest>& deliveries, const CancellationToken* cancel) const;
 };
 
+//changes whenever one of the settings above does, so plans ordered under old settings
+//are not mistaken for current ones
+unsigned long long optimizerSettingsChecksum()
+{
+	unsigned long long hash = 14695981039346656037ULL;
+	double settings[] = { LARGE_INSTANCE_STOPS, CLUSTER_STOPS, MAX_PATH_PASSES, START_TEMPERATURE, COOLING_RATE };
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(settings);
+	for (int i = 0; i < sizeof(settings); i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
 DeliveryOptimizerImpl::DeliveryOptimizerImpl(const StreetMap* sm)
 {
 }
@@ -59,15 +91,34 @@ double getDistance(const vector<DeliveryRequest>& deliveries, const GeoCoord& de
 	return distance;
 }
 
+//Gets the distance of entire route when visiting deliveries in the given order
+double getDistance(const vector<DeliveryRequest>& deliveries, const pmr::vector<int>& order, const GeoCoord& depot)
+{
+	int distance = 0;
+	const GeoCoord* start = &depot;
+	if (order.size() < 1)
+		return distance;
+	
+	for (int i = 0; i < order.size(); i++)
+	{
+		distance += distanceEarthMiles(*start, deliveries[order[i]].location);
+		start = &deliveries[order[i]].location;
+	}
+	distance += distanceEarthMiles(*start, depot);
+
+	return distance;
+}
+
 //simulated annealing algorithm to optimize delivery order
 void DeliveryOptimizerImpl::optimizeDeliveryOrder(
     const GeoCoord& depot,
     vector<DeliveryRequest>& deliveries,
     double& oldCrowDistance,
-    double& newCrowDistance) const
+    double& newCrowDistance,
+    const CancellationToken* cancel) const
 {
-	double temp = 10000;
-	double coolingRate = 0.003;
+	double temp = START_TEMPERATURE;
+	double coolingRate = COOLING_RATE;
 
 	oldCrowDistance = getDistance(deliveries, depot);
 
@@ -77,23 +128,38 @@ void DeliveryOptimizerImpl::optimizeDeliveryOrder(
 		return;
 	}
 
-	vector<DeliveryRequest> currentRoute = deliveries;
-	vector<DeliveryRequest> optimizedDeliveries = currentRoute;
+	if (deliveries.size() > LARGE_INSTANCE_STOPS)
+	{
+		optimizeLargeInstance(depot, deliveries, cancel);
+		newCrowDistance = getDistance(deliveries, depot);
+		return;
+	}
+
+	//routes are orders of indices into deliveries, so trying a swap copies ints instead of requests;
+	//the arena hands out all of their memory and frees it in one shot when optimizing is done
+	pmr::monotonic_buffer_resource arena;
+	pmr::vector<int> originalRoute(&arena);
+	for (int i = 0; i < deliveries.size(); i++)
+		originalRoute.push_back(i);
+	pmr::vector<int> currentRoute(originalRoute, &arena);
+	pmr::vector<int> optimizedDeliveries(originalRoute, &arena);
+	pmr::vector<int> newRoute(&arena);
+	newRoute.reserve(originalRoute.size());
 
-	while (temp > 1)
+	while (temp > 1 && (cancel == nullptr || !cancel->cancelled()))	//a cancelled caller gets the best so far
 	{
-		vector<DeliveryRequest> newRoute = deliveries;
+		newRoute = originalRoute;
 
 		//randomly switch 2 positions in the route
 		int position1 = rand() % deliveries.size();
 		int position2 = rand() % deliveries.size();
 
-		DeliveryRequest tempDeliv = newRoute[position1];
+		int tempDeliv = newRoute[position1];
 		newRoute[position1] = newRoute[position2];
 		newRoute[position2] = tempDeliv;
 	
-		int currentDistance = getDistance(currentRoute, depot);
-		int newDistance = getDistance(newRoute, depot);
+		int currentDistance = getDistance(deliveries, currentRoute, depot);
+		int newDistance = getDistance(deliveries, newRoute, depot);
 
 		//if the accept chance (between 0-1) is greater than than a 
 		//rand chance (0-1) accept it as the current solution
@@ -102,18 +168,178 @@ void DeliveryOptimizerImpl::optimizeDeliveryOrder(
 			currentRoute = newRoute;
 
 		//if the current route is shorter than the best current route, take it as the route
-		if (getDistance(currentRoute, depot) < getDistance(optimizedDeliveries, depot))
+		if (getDistance(deliveries, currentRoute, depot) < getDistance(deliveries, optimizedDeliveries, depot))
 			optimizedDeliveries = currentRoute;
 
 		//cool the system
 		temp *= 1 - coolingRate;
 	}
 
-	deliveries = optimizedDeliveries;
+	vector<DeliveryRequest> reordered;
+	reordered.reserve(deliveries.size());
+	for (int i = 0; i < optimizedDeliveries.size(); i++)
+		reordered.push_back(deliveries[optimizedDeliveries[i]]);
+	deliveries.swap(reordered);
 	newCrowDistance = getDistance(deliveries, depot);
 
 }
 
+//improve the open path stops[first..last) whose ends are joined to the fixed points before
+//and after, with 2-opt reversals and single stop moves until neither helps
+void optimizePath(const vector<DeliveryRequest>& deliveries, vector<int>& stops, int first, int last,
+	const GeoCoord& before, const GeoCoord& after, const CancellationToken* cancel)
+{
+	auto at = [&](int i) -> const GeoCoord&
+	{
+		if (i < first)
+			return before;
+		if (i >= last)
+			return after;
+		return deliveries[stops[i]].location;
+	};
+	auto dist = [](const GeoCoord& a, const GeoCoord& b) { return distanceEarthMiles(a, b); };
+	const double minGain = 1e-9;
+
+	for (int pass = 0; pass < MAX_PATH_PASSES; pass++)
+	{
+		if (cancel != nullptr && cancel->cancelled())
+			break;
+		bool improved = false;
+		for (int i = first; i < last; i++)	//reverse stops[i..j]
+		{
+			for (int j = i + 1; j < last; j++)
+			{
+				double delta = dist(at(i - 1), at(j)) + dist(at(i), at(j + 1)) - dist(at(i - 1), at(i)) - dist(at(j), at(j + 1));
+				if (delta < -minGain)
+				{
+					reverse(stops.begin() + i, stops.begin() + j + 1);
+					improved = true;
+				}
+			}
+		}
+		for (int i = first; i < last; i++)	//move stops[i] to just before stops[j]
+		{
+			double gain = dist(at(i - 1), at(i)) + dist(at(i), at(i + 1)) - dist(at(i - 1), at(i + 1));
+			int bestSpot = -1;
+			double bestCost = gain - minGain;
+			for (int j = first; j <= last; j++)
+			{
+				if (j == i || j == i + 1)
+					continue;
+				double cost = dist(at(j - 1), at(i)) + dist(at(i), at(j)) - dist(at(j - 1), at(j));
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestSpot = j;
+				}
+			}
+			if (bestSpot != -1)
+			{
+				int stop = stops[i];
+				if (bestSpot > i)
+				{
+					copy(stops.begin() + i + 1, stops.begin() + bestSpot, stops.begin() + i);
+					stops[bestSpot - 1] = stop;
+				}
+				else
+				{
+					copy_backward(stops.begin() + bestSpot, stops.begin() + i, stops.begin() + i + 1);
+					stops[bestSpot] = stop;
+				}
+				improved = true;
+			}
+		}
+		if (!improved)
+			break;
+	}
+}
+
+//for thousands of stops: start from the order the stops fall along a Hilbert curve, cut
+//that tour into clusters that are improved on separate threads, then improve windows
+//straddling the cluster boundaries, again in parallel since the windows don't overlap
+void DeliveryOptimizerImpl::optimizeLargeInstance(const GeoCoord& depot, vector<DeliveryRequest>& deliveries, const CancellationToken* cancel) const
+{
+	int numStops = deliveries.size();
+	double minLat = depot.latitude;
+	double maxLat = depot.latitude;
+	double minLon = depot.longitude;
+	double maxLon = depot.longitude;
+	for (int i = 0; i < numStops; i++)
+	{
+		minLat = min(minLat, deliveries[i].location.latitude);
+		maxLat = max(maxLat, deliveries[i].location.latitude);
+		minLon = min(minLon, deliveries[i].location.longitude);
+		maxLon = max(maxLon, deliveries[i].location.longitude);
+	}
+	vector<unsigned long long> keys(numStops);
+	vector<int> tour(numStops);
+	for (int i = 0; i < numStops; i++)
+	{
+		keys[i] = hilbertIndex(deliveries[i].location.latitude, deliveries[i].location.longitude, minLat, maxLat, minLon, maxLon);
+		tour[i] = i;
+	}
+	stable_sort(tour.begin(), tour.end(), [&keys](int a, int b) { return keys[a] < keys[b]; });
+
+	//treat the curve order as a loop and open it where visiting the depot costs least
+	int bestBreak = 0;
+	double bestCost = 0;
+	for (int i = 0; i < numStops; i++)
+	{
+		const GeoCoord& a = deliveries[tour[i]].location;
+		const GeoCoord& b = deliveries[tour[(i + 1) % numStops]].location;
+		double cost = distanceEarthMiles(a, depot) + distanceEarthMiles(depot, b) - distanceEarthMiles(a, b);
+		if (i == 0 || cost < bestCost)
+		{
+			bestCost = cost;
+			bestBreak = (i + 1) % numStops;
+		}
+	}
+	rotate(tour.begin(), tour.begin() + bestBreak, tour.end());
+
+	auto pointAt = [&](int i) -> const GeoCoord&
+	{
+		if (i < 0 || i >= numStops)
+			return depot;
+		return deliveries[tour[i]].location;
+	};
+	//each task's fixed ends are the first stop of the next piece and the last of the one
+	//before, which other threads are reordering meanwhile, so they are copied out first
+	int numClusters = (numStops + CLUSTER_STOPS - 1) / CLUSTER_STOPS;
+	vector<GeoCoord> before(numClusters);
+	vector<GeoCoord> after(numClusters);
+	for (int c = 0; c < numClusters; c++)
+	{
+		int first = c * CLUSTER_STOPS;
+		before[c] = pointAt(first - 1);
+		after[c] = pointAt(min(numStops, first + CLUSTER_STOPS));
+	}
+	parallelFor(numClusters, [&](int c)
+	{
+		int first = c * CLUSTER_STOPS;
+		int last = min(numStops, first + CLUSTER_STOPS);
+		optimizePath(deliveries, tour, first, last, before[c], after[c], cancel);
+	});
+	for (int c = 0; c + 1 < numClusters; c++)
+	{
+		int boundary = (c + 1) * CLUSTER_STOPS;
+		before[c] = pointAt(boundary - CLUSTER_STOPS / 2 - 1);
+		after[c] = pointAt(min(numStops, boundary + CLUSTER_STOPS / 2));
+	}
+	parallelFor(numClusters - 1, [&](int c)
+	{
+		int boundary = (c + 1) * CLUSTER_STOPS;
+		int first = boundary - CLUSTER_STOPS / 2;
+		int last = min(numStops, boundary + CLUSTER_STOPS / 2);
+		optimizePath(deliveries, tour, first, last, before[c], after[c], cancel);
+	});
+
+	vector<DeliveryRequest> reordered;
+	reordered.reserve(numStops);
+	for (int i = 0; i < numStops; i++)
+		reordered.push_back(deliveries[tour[i]]);
+	deliveries.swap(reordered);
+}
+
 //******************** DeliveryOptimizer functions ****************************
 
 // These functions simply delegate to DeliveryOptimizerImpl's functions.
@@ -135,5 +361,15 @@ void DeliveryOptimizer::optimizeDeliveryOrder(
         double& oldCrowDistance,
         double& newCrowDistance) const
 {
-    return m_impl->optimizeDeliveryOrder(depot, deliveries, oldCrowDistance, newCrowDistance);
+    return m_impl->optimizeDeliveryOrder(depot, deliveries, oldCrowDistance, newCrowDistance, nullptr);
+}
+
+void DeliveryOptimizer::optimizeDeliveryOrder(
+        const GeoCoord& depot,
+        vector<DeliveryRequest>& deliveries,
+        double& oldCrowDistance,
+        double& newCrowDistance,
+        const CancellationToken& cancel) const
+{
+    return m_impl->optimizeDeliveryOrder(depot, deliveries, oldCrowDistance, newCrowDistance, &cancel);
 }
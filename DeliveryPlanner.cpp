@@ -1,34 +1,53 @@
 #include "provided.h"
+#include "RouteSearch.h"
+#include "MapSnapshot.h"
+#include "PlanBuilder.h"
+#include "QueryLog.h"
+#include "PlanCache.h"
 #include <vector>
+#include <chrono>
+#include <memory>
+#include <memory_resource>
+#include <unordered_map>
 using namespace std;
 
+string angleDir(double angle);
+
 class DeliveryPlannerImpl
 {
 public:
-    DeliveryPlannerImpl(const StreetMap* sm);
+    DeliveryPlannerImpl(const StreetMap* sm, PlanCache* cache);
     ~DeliveryPlannerImpl();
     DeliveryResult generateDeliveryPlan(
         const GeoCoord& depot,
         const vector<DeliveryRequest>& deliveries,
         vector<DeliveryCommand>& commands,
+        double& totalDistanceTravelled,
+        const CancellationToken* cancel) const;
+    DeliveryResult generateDeliveryPlan(
+        const GeoCoord& depot,
+        const vector<DeliveryRequest>& deliveries,
+        DeliveryCommandSink& sink,
         double& totalDistanceTravelled) const;
 private:
-	PointToPointRouter* m_pathFinder;
-	string angleDir(double angle) const;
+	const StreetMap* m_streetMap;
 	DeliveryOptimizer* m_optimizer;
-
+	PlanCache* m_cache;
+	DeliveryResult planDeliveries(const GeoCoord& depot, const vector<DeliveryRequest>& deliveries,
+		DeliveryCommandSink& sink, double& totalDistanceTravelled, const CancellationToken* cancel) const;
+	DeliveryResult orderDeliveries(const GeoCoord& depot, const vector<DeliveryRequest>& deliveries,
+		const MapSnapshot& map, vector<DeliveryRequest>& optimizedDeliveries, const CancellationToken* cancel) const;
 };
 
-DeliveryPlannerImpl::DeliveryPlannerImpl(const StreetMap* sm)
+DeliveryPlannerImpl::DeliveryPlannerImpl(const StreetMap* sm, PlanCache* cache)
 {
-	m_pathFinder = new PointToPointRouter(sm);
+	m_streetMap = sm;
 	m_optimizer = new DeliveryOptimizer(sm);
-
+	m_cache = cache;
 }
 
 DeliveryPlannerImpl::~DeliveryPlannerImpl()
 {
-	delete m_pathFinder;
 	delete m_optimizer;
 }
 
@@ -36,123 +55,268 @@ DeliveryResult DeliveryPlannerImpl::generateDeliveryPlan(
     const GeoCoord& depot,
     const vector<DeliveryRequest>& deliveries,
     vector<DeliveryCommand>& commands,
-    double& totalDistanceTravelled) const
+    double& totalDistanceTravelled,
+    const CancellationToken* cancel) const
 {
+	QueryLog* log = QueryLog::active();
+	chrono::steady_clock::time_point started;
+	if (log != nullptr)
+		started = chrono::steady_clock::now();
 	commands.clear();
+	CommandListSink sink(commands);
+	DeliveryResult result = planDeliveries(depot, deliveries, sink, totalDistanceTravelled, cancel);
+	if (result != DELIVERY_SUCCESS)
+		commands.clear();
+	if (log != nullptr)
+		log->recordPlan(started, depot, deliveries, result, totalDistanceTravelled, commands.size());
+	return result;
+}
+
+DeliveryResult DeliveryPlannerImpl::generateDeliveryPlan(
+    const GeoCoord& depot,
+    const vector<DeliveryRequest>& deliveries,
+    DeliveryCommandSink& sink,
+    double& totalDistanceTravelled) const
+{
+	QueryLog* log = QueryLog::active();
+	chrono::steady_clock::time_point started;
+	if (log != nullptr)
+		started = chrono::steady_clock::now();
+	DeliveryResult result = planDeliveries(depot, deliveries, sink, totalDistanceTravelled, nullptr);
+	if (log != nullptr)
+		log->recordPlan(started, depot, deliveries, result, totalDistanceTravelled, -1);
+	return result;
+}
+
+//a plan the cache already holds is described straight from it; otherwise the stops are
+//ordered and routed, and the finished plan is handed to the cache
+DeliveryResult DeliveryPlannerImpl::planDeliveries(const GeoCoord& depot, const vector<DeliveryRequest>& deliveries,
+	DeliveryCommandSink& sink, double& totalDistanceTravelled, const CancellationToken* cancel) const
+{
 	totalDistanceTravelled = 0;
+	//the whole plan is made against this version of the map even if a new one is loaded meanwhile
+	shared_ptr<const MapSnapshot> map = m_streetMap->getSnapshot();
+	if (map == nullptr)
+		return BAD_COORD;
+	CompactPlan plan;
+	if (m_cache != nullptr && m_cache->find(*map, depot, deliveries, plan))
+	{
+		describePlan(*map->graph, deliveries, plan, sink);
+		totalDistanceTravelled = plan.totalDistanceTravelled;
+		return DELIVERY_SUCCESS;
+	}
+
+	vector<DeliveryRequest> optimizedDeliveries;
+	DeliveryResult result = orderDeliveries(depot, deliveries, *map, optimizedDeliveries, cancel);
+	if (result != DELIVERY_SUCCESS)
+		return result;
+	result = streamDeliveryPlan(*map, depot, optimizedDeliveries, sink, totalDistanceTravelled, cancel,
+		m_cache != nullptr ? &plan : nullptr);
+	if (result != DELIVERY_SUCCESS)
+	{
+		totalDistanceTravelled = 0;
+		return result;
+	}
+	if (m_cache != nullptr)
+	{
+		//the optimizer hands back reordered copies, so find where each came from; equal
+		//requests are interchangeable
+		unordered_map<string, vector<int>> positions;
+		for (int i = deliveries.size() - 1; i >= 0; i--)
+			positions[deliveries[i].location.latitudeText + " " + deliveries[i].location.longitudeText + ":" + deliveries[i].item].push_back(i);
+		for (int i = 0; i < optimizedDeliveries.size(); i++)
+		{
+			vector<int>& same = positions[optimizedDeliveries[i].location.latitudeText + " "
+				+ optimizedDeliveries[i].location.longitudeText + ":" + optimizedDeliveries[i].item];
+			plan.order.push_back(same.back());
+			same.pop_back();
+		}
+		m_cache->store(*map, depot, deliveries, plan);
+	}
+	return DELIVERY_SUCCESS;
+}
+
+//check the stops against the map and put them in the order they will be delivered
+DeliveryResult DeliveryPlannerImpl::orderDeliveries(const GeoCoord& depot, const vector<DeliveryRequest>& deliveries,
+	const MapSnapshot& map, vector<DeliveryRequest>& optimizedDeliveries, const CancellationToken* cancel) const
+{
+	DeliveryResult validation = validateDeliveries(*map.graph, depot, deliveries);	//reject the whole plan before any routing is done
+	if (validation != DELIVERY_SUCCESS)
+		return validation;
 
 	double oldDist = 0;
 	double newDist = 0;
 
-	vector<DeliveryRequest> optimizedDeliveries = deliveries;
+	optimizedDeliveries = deliveries;
+
+	if (cancel == nullptr)
+		m_optimizer->optimizeDeliveryOrder(depot, optimizedDeliveries, oldDist, newDist);
+	else
+	{
+		m_optimizer->optimizeDeliveryOrder(depot, optimizedDeliveries, oldDist, newDist, *cancel);
+		if (cancel->cancelled())
+			return CANCELLED;
+	}
+	return DELIVERY_SUCCESS;
+}
 
-	m_optimizer->optimizeDeliveryOrder(depot, optimizedDeliveries, oldDist, newDist);
+DeliveryResult buildDeliveryPlan(const MapSnapshot& map, const GeoCoord& depot,
+	const vector<DeliveryRequest>& deliveries, vector<DeliveryCommand>& commands, double& totalDistanceTravelled,
+	const CancellationToken* cancel, CompactPlan* compact)
+{
+	commands.clear();
+	CommandListSink sink(commands);
+	DeliveryResult result = streamDeliveryPlan(map, depot, deliveries, sink, totalDistanceTravelled, cancel, compact);
+	if (result != DELIVERY_SUCCESS)
+	{
+		commands.clear();
+		totalDistanceTravelled = 0;
+	}
+	return result;
+}
 
-	list<StreetSegment> deliveryRoute;
-	GeoCoord start = depot;
+DeliveryResult streamDeliveryPlan(const MapSnapshot& map, const GeoCoord& depot,
+	const vector<DeliveryRequest>& deliveries, DeliveryCommandSink& sink, double& totalDistanceTravelled,
+	const CancellationToken* cancel, CompactPlan* compact)
+{
+	totalDistanceTravelled = 0;
+	if (compact != nullptr)
+	{
+		compact->edges.clear();
+		compact->legStarts.clear();
+	}
+	const StreetGraph& graph = *map.graph;
+	//scratch memory for the whole plan comes from one arena and is released in one shot on
+	//return; every leg reuses the same scratch and edge list, so it stops growing after the
+	//longest leg no matter how many stops there are
+	pmr::monotonic_buffer_resource arena;
+	RouteScratch scratch(graph, &arena);
+	EdgeRoute legEdges(&arena);
+	int start = graph.findNode(depot);
 	double distance = 0;
-	vector<list<StreetSegment>> totalRoute;
-	for (int i = 0; i < deliveries.size(); i++)		//ensure that deliveries are valid, and push them onto a vector to be processed
+	for (int i = 0; i <= deliveries.size(); i++)		//route each leg and describe it
 	{
+		//the last leg is the route to return to depot
+		int end = graph.findNode(i < deliveries.size() ? deliveries[i].location : depot);
 		DeliveryResult deliveryCheck;
-		deliveryCheck = m_pathFinder->generatePointToPointRoute(start, optimizedDeliveries[i].location, deliveryRoute, distance);
+		deliveryCheck = searchRoute(map, start, end, legEdges, distance, scratch, 1, nullptr, cancel);
+		if (deliveryCheck == DELIVERY_SUCCESS && cancel != nullptr && cancel->cancelled())	//short legs may never check
+			deliveryCheck = CANCELLED;
 		
 		if (deliveryCheck != DELIVERY_SUCCESS)
+		{
+			totalDistanceTravelled = 0;
 			return deliveryCheck;
+		}
 		totalDistanceTravelled += distance;
-		totalRoute.push_back(deliveryRoute);
-		start = deliveries[i].location;
+		if (compact != nullptr)
+		{
+			compact->legStarts.push_back(compact->edges.size());
+			compact->edges.insert(compact->edges.end(), legEdges.begin(), legEdges.end());
+		}
+		describeLeg(graph, legEdges, i < deliveries.size() ? &deliveries[i] : nullptr, sink);
+		start = end;
 	}
-	m_pathFinder->generatePointToPointRoute(start, depot, deliveryRoute, distance);		//add route to return to depot
-	totalDistanceTravelled += distance;
-	totalRoute.push_back(deliveryRoute);
-	
+	if (compact != nullptr)
+	{
+		compact->legStarts.push_back(compact->edges.size());
+		compact->totalDistanceTravelled = totalDistanceTravelled;
+	}
+	return DELIVERY_SUCCESS;
+}
+
+void describePlan(const StreetGraph& graph, const vector<DeliveryRequest>& deliveries,
+	const CompactPlan& plan, DeliveryCommandSink& sink)
+{
+	EdgeRoute legEdges;
+	for (int i = 0; i + 1 < plan.legStarts.size(); i++)
+	{
+		legEdges.assign(plan.edges.begin() + plan.legStarts[i], plan.edges.begin() + plan.legStarts[i + 1]);
+		describeLeg(graph, legEdges, i < plan.order.size() ? &deliveries[plan.order[i]] : nullptr, sink);
+	}
+}
+
+void sendProceed(const StreetGraph& graph, int edge, double distance, DeliveryCommandSink& sink)
+{
+	DeliveryCommand proceed;
+	proceed.initAsProceedCommand(angleDir(angleOfLine(graph.segment(edge))), graph.edgeName(edge), distance);
+	sink.receive(proceed);
+}
 
-	for (int i = 0; i < totalRoute.size(); i++)
+//walks the edges directly; the street being proceeded along runs from edge proceedFirst to
+//edge proceedLast, and proceedFirst is -1 right after a turn
+void describeLeg(const StreetGraph& graph, const EdgeRoute& edges,
+	const DeliveryRequest* delivery, DeliveryCommandSink& sink)
+{
+	int proceedFirst = -1;
+	int proceedLast = -1;
+	double proceedDistance = 0;
+	for (int i = 0; i < edges.size(); i++)
 	{
-		list<StreetSegment>::iterator it;	
-		it = totalRoute[i].begin();
-		double proceedDistance = 0;
-		vector<StreetSegment> proceedList;
-		list<StreetSegment>::iterator lastFinder;	//finds last element of the list
-		lastFinder = totalRoute[i].end();
-		lastFinder--;
-		for (; it != totalRoute[i].end(); it++)
+		int edge = edges[i];
+		if (i == edges.size() - 1)	//need to proceed down last street segment
+		{
+			if (proceedFirst == -1)
+				proceedFirst = edge;
+			proceedDistance += graph.edgeLength(edge);
+			sendProceed(graph, proceedFirst, proceedDistance, sink);
+			break;
+		}
+		if (proceedFirst == -1 || graph.edgeName(edge) == graph.edgeName(proceedLast))	//if on same road, combine commands
 		{
-			
-			if (it == lastFinder)
+			if (proceedFirst == -1)
+				proceedFirst = edge;
+			proceedLast = edge;
+			proceedDistance += graph.edgeLength(edge);
+		}
+		else                                //if on different road, need to turn
+		{
+			if (proceedDistance != 0)		//first complete any held proceed street segments
 			{
-				proceedList.push_back(*it);				//need to proceed down last street segment
-				proceedDistance += distanceEarthMiles(it->start, it->end);
-
-				double angle = angleOfLine(proceedList[0]);
-				DeliveryCommand proceed;
-				const string dir = angleDir(angle);
-				proceed.initAsProceedCommand(dir, proceedList[0].name, proceedDistance);
-				commands.push_back(proceed);
+				sendProceed(graph, proceedFirst, proceedDistance, sink);
 				proceedDistance = 0;
-
-				if (i != (totalRoute.size() - 1))	//ensure that the route is making a delivery, not returning to the depot
-				{
-					DeliveryCommand deliver;
-					deliver.initAsDeliverCommand(deliveries[i].item);
-					commands.push_back(deliver);
-				}
-				break;
 			}
-			if (proceedList.empty())	//if not proceeding, add segment to proceed
+			double theta = angleBetween2Lines(graph.segment(proceedLast), graph.segment(edge));
+			proceedFirst = -1;
+			if (theta < 1 || theta > 359)	//if angle is small enough, it is more like going straight
+				sendProceed(graph, edge, graph.edgeLength(edge), sink);
+			else                            //if it is larger, make turn
 			{
-				proceedList.push_back(*it);
-				proceedDistance += distanceEarthMiles(it->start, it->end);
+				DeliveryCommand turn;
+				turn.initAsTurnCommand(theta < 180 ? "left" : "right", graph.edgeName(edge));
+				sink.receive(turn);
 			}
-			else if (it->name == proceedList.back().name)	//if on same road, combine commands
-			{
-				proceedList.push_back(*it);
-				proceedDistance += distanceEarthMiles(it->start, it->end);
-			}
-			else if (it->name != proceedList.back().name)	//if on different road, need to turn
-			{
-				if (proceedDistance != 0)		//first complete any held proceed street segments
-				{
-					double angle = angleOfLine(proceedList[0]);
-					DeliveryCommand proceed;
-					const string dir = angleDir(angle);
-					proceed.initAsProceedCommand(dir, proceedList[0].name, proceedDistance);
-					commands.push_back(proceed);
-					proceedDistance = 0;
-					
-				}
-				double theta = angleBetween2Lines(proceedList.back(), *it);	
-				proceedList.clear();
-				if (theta < 1 || theta > 359)	//if angle is small enough, it is more like going straight
-				{
-					double angle = angleOfLine(*it);
-					DeliveryCommand proceed;
-					const string dir = angleDir(angle);
-					proceed.initAsProceedCommand(dir, it->name, distanceEarthMiles(it->start, it->end));
-					commands.push_back(proceed);
-				}
-				else                            //if it is larger, make turn
-				{
-					string leftOrRight;
-					if (theta >= 1 && theta < 180)
-						leftOrRight = "left";
-					else
-						leftOrRight = "right";
-					DeliveryCommand turn;
-					turn.initAsTurnCommand(leftOrRight, it->name);
-					commands.push_back(turn);
-				}
-			}
-
 		}
-		
 	}
+	if (delivery != nullptr)	//ensure that the route is making a delivery, not returning to the depot
+	{
+		DeliveryCommand deliver;
+		deliver.initAsDeliverCommand(delivery->item);
+		sink.receive(deliver);
+	}
+}
+
+//every stop must be on the map and in the same connected component as the depot
+DeliveryResult validateDeliveries(const StreetGraph& graph, const GeoCoord& depot, const vector<DeliveryRequest>& deliveries)
+{
+	int depotNode = graph.findNode(depot);
+	if (depotNode == -1)
+		return BAD_COORD;
+	bool unreachable = false;
+	for (int i = 0; i < deliveries.size(); i++)
+	{
+		int node = graph.findNode(deliveries[i].location);
+		if (node == -1)
+			return BAD_COORD;	//bad coords take priority over unreachable ones
+		if (graph.component(node) != graph.component(depotNode))
+			unreachable = true;
+	}
+	if (unreachable)
+		return NO_ROUTE;
 	return DELIVERY_SUCCESS;
-    
 }
 
-string DeliveryPlannerImpl::angleDir(double angle) const	//find correct angle direction
+string angleDir(double angle)	//find correct angle direction
 {
 	if (angle >= 0 && angle < 22.5)
 		return "east";
@@ -181,7 +345,12 @@ string DeliveryPlannerImpl::angleDir(double angle) const	//find correct angle di
 
 DeliveryPlanner::DeliveryPlanner(const StreetMap* sm)
 {
-    m_impl = new DeliveryPlannerImpl(sm);
+    m_impl = new DeliveryPlannerImpl(sm, nullptr);
+}
+
+DeliveryPlanner::DeliveryPlanner(const StreetMap* sm, PlanCache* cache)
+{
+    m_impl = new DeliveryPlannerImpl(sm, cache);
 }
 
 DeliveryPlanner::~DeliveryPlanner()
@@ -195,5 +364,24 @@ DeliveryResult DeliveryPlanner::generateDeliveryPlan(
     vector<DeliveryCommand>& commands,
     double& totalDistanceTravelled) const
 {
-    return m_impl->generateDeliveryPlan(depot, deliveries, commands, totalDistanceTravelled);
+    return m_impl->generateDeliveryPlan(depot, deliveries, commands, totalDistanceTravelled, nullptr);
+}
+
+DeliveryResult DeliveryPlanner::generateDeliveryPlan(
+    const GeoCoord& depot,
+    const vector<DeliveryRequest>& deliveries,
+    DeliveryCommandSink& sink,
+    double& totalDistanceTravelled) const
+{
+    return m_impl->generateDeliveryPlan(depot, deliveries, sink, totalDistanceTravelled);
+}
+
+DeliveryResult DeliveryPlanner::generateDeliveryPlan(
+    const GeoCoord& depot,
+    const vector<DeliveryRequest>& deliveries,
+    vector<DeliveryCommand>& commands,
+    double& totalDistanceTravelled,
+    const CancellationToken& cancel) const
+{
+    return m_impl->generateDeliveryPlan(depot, deliveries, commands, totalDistanceTravelled, &cancel);
 }
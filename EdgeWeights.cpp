@@ -0,0 +1,100 @@
+#include "EdgeWeights.h"
+#include <algorithm>
+#include <memory>
+#include <vector>
+using namespace std;
+
+EdgeWeights::EdgeWeights()
+{
+}
+
+shared_ptr<const EdgeWeights> EdgeWeights::withChanges(const vector<pair<int, double>>& changes) const
+{
+	//sorting groups the changes by page, so each page is copied once however many of its edges change
+	vector<pair<int, double>> sorted(changes);
+	stable_sort(sorted.begin(), sorted.end(),
+		[](const pair<int, double>& a, const pair<int, double>& b) { return a.first < b.first; });
+
+	shared_ptr<Root> root = make_shared<Root>();
+	if (m_root != nullptr)
+		*root = *m_root;	//copies the pointers to the pages, not the pages
+	shared_ptr<Middle> middle;
+	shared_ptr<Leaf> leaf;
+	int middleNum = -1;
+	int leafNum = -1;
+
+	auto finishLeaf = [&]()
+	{
+		if (leaf == nullptr)
+			return;
+		leaf->minimum = *min_element(leaf->values, leaf->values + PAGE_SIZE);
+		bool allOne = leaf->minimum == 1 && *max_element(leaf->values, leaf->values + PAGE_SIZE) == 1;
+		middle->children[leafNum] = allOne ? nullptr : leaf;	//a missing page is all ones
+		leaf = nullptr;
+	};
+	auto finishMiddle = [&]()
+	{
+		if (middle == nullptr)
+			return;
+		middle->minimum = 1;
+		bool empty = true;
+		for (int i = 0; i < PAGE_SIZE; i++)
+		{
+			if (middle->children[i] != nullptr)
+			{
+				middle->minimum = min(middle->minimum, middle->children[i]->minimum);
+				empty = false;
+			}
+		}
+		root->children[middleNum] = empty ? nullptr : middle;
+		middle = nullptr;
+	};
+
+	for (int i = 0; i < sorted.size(); i++)
+	{
+		int edge = sorted[i].first;
+		if (edge < 0 || edge >= MAX_EDGES)
+			continue;
+		if (edge >> (2 * PAGE_BITS) != middleNum)	//copy the page on the way to this edge, or start an empty one
+		{
+			finishLeaf();
+			finishMiddle();
+			middleNum = edge >> (2 * PAGE_BITS);
+			middle = make_shared<Middle>();
+			if (root->children[middleNum] != nullptr)
+				*middle = *root->children[middleNum];
+			leafNum = -1;
+		}
+		if (((edge >> PAGE_BITS) & PAGE_MASK) != leafNum)
+		{
+			finishLeaf();
+			leafNum = (edge >> PAGE_BITS) & PAGE_MASK;
+			leaf = make_shared<Leaf>();
+			if (middle->children[leafNum] != nullptr)
+				*leaf = *middle->children[leafNum];
+			else
+				fill(leaf->values, leaf->values + PAGE_SIZE, 1.0);
+		}
+		leaf->values[edge & PAGE_MASK] = sorted[i].second;
+	}
+	finishLeaf();
+	finishMiddle();
+
+	root->minimum = 1;
+	bool empty = true;
+	for (int i = 0; i < PAGE_SIZE; i++)
+	{
+		if (root->children[i] != nullptr)
+		{
+			root->minimum = min(root->minimum, root->children[i]->minimum);
+			empty = false;
+		}
+	}
+
+	//once every multiplier is back to 1 the weights are unchanged again, so searches can
+	//use the hub trees and the plan cache can skip hashing the weights
+	shared_ptr<EdgeWeights> weights = make_shared<EdgeWeights>();
+	if (!empty)
+		weights->m_root = root;
+	return weights;
+}
@@ -0,0 +1,72 @@
+// EdgeWeights.h
+
+// Per-edge cost multipliers layered over a StreetGraph: driving an edge costs its length
+// times its multiplier, and a closed edge has an infinite multiplier.  Every edge starts
+// at 1.
+//
+// An EdgeWeights is never modified once built.  withChanges makes a new one that shares
+// everything the changes don't touch: multipliers live in a three level tree of fixed
+// size pages, and only the pages on the path to a changed edge are copied, so the cost
+// of a batch depends on the size of the batch and not on the size of the map.
+#ifndef EDGEWEIGHTS_INCLUDED
+#define EDGEWEIGHTS_INCLUDED
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+class EdgeWeights
+{
+public:
+	EdgeWeights();
+
+	double multiplier(int edge) const
+	{
+		if (m_root == nullptr)
+			return 1;
+		const Middle* middle = m_root->children[edge >> (2 * PAGE_BITS)].get();
+		if (middle == nullptr)
+			return 1;
+		const Leaf* leaf = middle->children[(edge >> PAGE_BITS) & PAGE_MASK].get();
+		if (leaf == nullptr)
+			return 1;
+		return leaf->values[edge & PAGE_MASK];
+	}
+
+	  // true while every multiplier is 1, so every edge costs its length
+	bool unchanged() const { return m_root == nullptr; }
+
+	  // no edge has a smaller multiplier; never more than 1
+	double minMultiplier() const { return m_root == nullptr ? 1 : m_root->minimum; }
+
+	  // edge number, new multiplier pairs; later pairs for the same edge win
+	std::shared_ptr<const EdgeWeights> withChanges(const std::vector<std::pair<int, double>>& changes) const;
+
+	  // largest number of edges a graph can have and still be weighted
+	static const int MAX_EDGES = 1 << (3 * 9);
+
+private:
+	static const int PAGE_BITS = 9;
+	static const int PAGE_SIZE = 1 << PAGE_BITS;
+	static const int PAGE_MASK = PAGE_SIZE - 1;
+
+	struct Leaf
+	{
+		double values[PAGE_SIZE];
+		double minimum;
+	};
+	struct Middle
+	{
+		std::shared_ptr<const Leaf> children[PAGE_SIZE];
+		double minimum;
+	};
+	struct Root
+	{
+		std::shared_ptr<const Middle> children[PAGE_SIZE];
+		double minimum;
+	};
+
+	std::shared_ptr<const Root> m_root;
+};
+
+#endif // EDGEWEIGHTS_INCLUDED
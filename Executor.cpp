@@ -0,0 +1,49 @@
+#include "Executor.h"
+#include <algorithm>
+using namespace std;
+
+Executor::Executor(int numThreads)
+{
+	m_stopping = false;
+	if (numThreads <= 0)
+		numThreads = max(1u, thread::hardware_concurrency());
+	for (int i = 0; i < numThreads; i++)
+		m_workers.push_back(thread(&Executor::work, this));
+}
+
+Executor::~Executor()
+{
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_taskReady.notify_all();
+	for (int i = 0; i < m_workers.size(); i++)
+		m_workers[i].join();
+}
+
+void Executor::submit(function<void()> task)
+{
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_tasks.push_back(std::move(task));
+	}
+	m_taskReady.notify_one();
+}
+
+void Executor::work()
+{
+	for (;;)
+	{
+		function<void()> task;
+		{
+			unique_lock<mutex> lock(m_mutex);
+			m_taskReady.wait(lock, [this] { return !m_tasks.empty() || m_stopping; });
+			if (m_tasks.empty())	//stopping and nothing is left
+				return;
+			task = std::move(m_tasks.front());
+			m_tasks.pop_front();
+		}
+		task();
+	}
+}
@@ -0,0 +1,38 @@
+// Executor.h
+
+// A fixed pool of worker threads running tasks in the order they were submitted, for
+// work that is handed off and collected later rather than waited for on the spot.
+#ifndef EXECUTOR_INCLUDED
+#define EXECUTOR_INCLUDED
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class Executor
+{
+public:
+	  // numThreads workers, or one per core if it is 0
+	Executor(int numThreads);
+	  // runs every task already submitted, then stops the workers
+	~Executor();
+	void submit(std::function<void()> task);
+	int threadCount() const { return m_workers.size(); }
+
+	Executor(const Executor&) = delete;
+	Executor& operator=(const Executor&) = delete;
+
+private:
+	std::mutex m_mutex;
+	std::condition_variable m_taskReady;
+	std::deque<std::function<void()>> m_tasks;
+	bool m_stopping;
+	std::vector<std::thread> m_workers;
+
+	void work();
+};
+
+#endif // EXECUTOR_INCLUDED
@@ -2,6 +2,9 @@
 
 // Skeleton for the ExpandableHashMap class template.  You must implement the first six
 // member functions.
+#ifndef EXPANDABLEHASHMAP_INCLUDED
+#define EXPANDABLEHASHMAP_INCLUDED
+
 #include <vector>
 #include <list>
 #include "provided.h"
@@ -162,3 +165,4 @@ unsigned int ExpandableHashMap<KeyType, ValueType>::getBucketNum(const KeyType&
 	return bucketNum;
 }
 
+#endif // EXPANDABLEHASHMAP_INCLUDED
@@ -0,0 +1,307 @@
+#include "provided.h"
+#include "FleetPlanner.h"
+#include "PlanBuilder.h"
+#include "MapSnapshot.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <memory>
+#include <vector>
+using namespace std;
+
+class FleetPlannerImpl
+{
+public:
+    FleetPlannerImpl(const StreetMap* sm, int numWorkers);
+    ~FleetPlannerImpl();
+    DeliveryResult generateFleetPlan(
+        const GeoCoord& depot,
+        const vector<DeliveryRequest>& deliveries,
+        int numVehicles,
+        const vector<int>& capacities,
+        vector<vector<DeliveryCommand>>& commands,
+        vector<double>& distances,
+        double& totalDistanceTravelled) const;
+private:
+	const StreetMap* m_streetMap;
+	DeliveryOptimizer* m_optimizer;
+	int m_numWorkers;
+	void sweep(const GeoCoord& depot, const vector<DeliveryRequest>& deliveries, const vector<int>& capacities,
+		vector<vector<DeliveryRequest>>& routes) const;
+	bool relocate(const GeoCoord& depot, const vector<int>& capacities, vector<vector<DeliveryRequest>>& routes) const;
+	bool exchange(const GeoCoord& depot, vector<vector<DeliveryRequest>>& routes) const;
+};
+
+//smallest improvement in miles worth making a move for
+const double MIN_GAIN = 1e-9;
+//relocate and exchange passes are repeated at most this many times
+const int MAX_IMPROVEMENT_PASSES = 50;
+
+//the stop before or after position i of a route, which is the depot at either end
+const GeoCoord& stopAt(const GeoCoord& depot, const vector<DeliveryRequest>& route, int i)
+{
+	if (i < 0 || i >= route.size())
+		return depot;
+	return route[i].location;
+}
+
+//how much shorter a route gets if the stop at position i is dropped
+double removalGain(const GeoCoord& depot, const vector<DeliveryRequest>& route, int i)
+{
+	const GeoCoord& prev = stopAt(depot, route, i - 1);
+	const GeoCoord& next = stopAt(depot, route, i + 1);
+	return distanceEarthMiles(prev, route[i].location) + distanceEarthMiles(route[i].location, next)
+		- distanceEarthMiles(prev, next);
+}
+
+//how much longer a route gets if the stop at position i is replaced with gc
+double replacementCost(const GeoCoord& depot, const vector<DeliveryRequest>& route, int i, const GeoCoord& gc)
+{
+	const GeoCoord& prev = stopAt(depot, route, i - 1);
+	const GeoCoord& next = stopAt(depot, route, i + 1);
+	return distanceEarthMiles(prev, gc) + distanceEarthMiles(gc, next) - removalGain(depot, route, i)
+		- distanceEarthMiles(prev, next);
+}
+
+FleetPlannerImpl::FleetPlannerImpl(const StreetMap* sm, int numWorkers)
+{
+	m_streetMap = sm;
+	m_optimizer = new DeliveryOptimizer(sm);
+	m_numWorkers = numWorkers;
+}
+
+FleetPlannerImpl::~FleetPlannerImpl()
+{
+	delete m_optimizer;
+}
+
+DeliveryResult FleetPlannerImpl::generateFleetPlan(
+    const GeoCoord& depot,
+    const vector<DeliveryRequest>& deliveries,
+    int numVehicles,
+    const vector<int>& capacities,
+    vector<vector<DeliveryCommand>>& commands,
+    vector<double>& distances,
+    double& totalDistanceTravelled) const
+{
+	commands.clear();
+	distances.clear();
+	totalDistanceTravelled = 0;
+	if (numVehicles < 1)
+		return NO_ROUTE;
+
+	//every vehicle plans against the same version of the map
+	shared_ptr<const MapSnapshot> map = m_streetMap->getSnapshot();
+	if (map == nullptr)
+		return BAD_COORD;
+	DeliveryResult validation = validateDeliveries(*map->graph, depot, deliveries);
+	if (validation != DELIVERY_SUCCESS)
+		return validation;
+
+	vector<int> limits(numVehicles, INT_MAX);	//vehicles without a capacity can carry anything
+	long long totalCapacity = 0;
+	for (int v = 0; v < numVehicles; v++)
+	{
+		if (v < capacities.size())
+			limits[v] = max(capacities[v], 0);
+		totalCapacity += limits[v];
+	}
+	if (totalCapacity < (long long)deliveries.size())
+		return NO_ROUTE;
+
+	vector<vector<DeliveryRequest>> routes;
+	sweep(depot, deliveries, limits, routes);
+
+	//optimize every vehicle's order in parallel; each task only touches its own route
+	DeliveryOptimizer* optimizer = m_optimizer;
+	auto optimizeRoute = [&depot, optimizer](vector<DeliveryRequest>* route)
+	{
+		double oldDist = 0;
+		double newDist = 0;
+		optimizer->optimizeDeliveryOrder(depot, *route, oldDist, newDist);
+	};
+	parallelFor(numVehicles, [&](int v)
+	{
+		optimizeRoute(&routes[v]);
+	}, m_numWorkers);
+
+	//move stops between vehicles while that shortens the fleet's total distance
+	for (int pass = 0; pass < MAX_IMPROVEMENT_PASSES; pass++)
+	{
+		bool relocated = relocate(depot, limits, routes);
+		bool exchanged = exchange(depot, routes);
+		if (!relocated && !exchanged)
+			break;
+	}
+
+	//route and describe every vehicle's tour in parallel
+	commands.resize(numVehicles);
+	distances.resize(numVehicles, 0);
+	vector<DeliveryResult> results(numVehicles, DELIVERY_SUCCESS);
+	parallelFor(numVehicles, [&](int v)
+	{
+		if (routes[v].empty())
+			return;
+		optimizeRoute(&routes[v]);
+		results[v] = buildDeliveryPlan(*map, depot, routes[v], commands[v], distances[v]);
+	}, m_numWorkers);
+	DeliveryResult result = DELIVERY_SUCCESS;
+	for (int v = 0; v < numVehicles; v++)
+	{
+		if (results[v] != DELIVERY_SUCCESS)
+			result = results[v];
+		totalDistanceTravelled += distances[v];
+	}
+	if (result != DELIVERY_SUCCESS)
+	{
+		commands.clear();
+		distances.clear();
+		totalDistanceTravelled = 0;
+	}
+	return result;
+}
+
+//sort stops by their angle around the depot, starting after the widest empty wedge,
+//and hand consecutive runs of them to each vehicle
+void FleetPlannerImpl::sweep(const GeoCoord& depot, const vector<DeliveryRequest>& deliveries, const vector<int>& capacities,
+	vector<vector<DeliveryRequest>>& routes) const
+{
+	int numVehicles = capacities.size();
+	int numStops = deliveries.size();
+	routes.assign(numVehicles, vector<DeliveryRequest>());
+	if (numStops == 0)
+		return;
+
+	const double PI = acos(-1.0);
+	vector<double> angles(numStops);
+	vector<int> order(numStops);
+	for (int i = 0; i < numStops; i++)
+	{
+		angles[i] = atan2(deliveries[i].location.latitude - depot.latitude, deliveries[i].location.longitude - depot.longitude);
+		order[i] = i;
+	}
+	stable_sort(order.begin(), order.end(), [&angles](int a, int b) { return angles[a] < angles[b]; });
+	int first = 0;
+	double widestGap = -1;
+	for (int i = 0; i < numStops; i++)
+	{
+		double gap = angles[order[(i + 1) % numStops]] - angles[order[i]];
+		if (gap < 0 || (gap == 0 && numStops == 1))
+			gap += 2 * PI;
+		if (gap > widestGap)
+		{
+			widestGap = gap;
+			first = (i + 1) % numStops;
+		}
+	}
+
+	//share the stops evenly, but never give a vehicle more than it can carry or leave
+	//more than the vehicles after it can carry
+	vector<long long> laterCapacity(numVehicles + 1, 0);
+	for (int v = numVehicles - 1; v >= 0; v--)
+		laterCapacity[v] = laterCapacity[v + 1] + capacities[v];
+	int next = 0;
+	for (int v = 0; v < numVehicles; v++)
+	{
+		long long remaining = numStops - next;
+		long long share = (remaining + (numVehicles - v) - 1) / (numVehicles - v);
+		long long quota = min((long long)capacities[v], max(share, remaining - laterCapacity[v + 1]));
+		for (int i = 0; i < quota; i++, next++)
+			routes[v].push_back(deliveries[order[(first + next) % numStops]]);
+	}
+}
+
+//move single stops to the cheapest spot in another vehicle's route
+bool FleetPlannerImpl::relocate(const GeoCoord& depot, const vector<int>& capacities, vector<vector<DeliveryRequest>>& routes) const
+{
+	bool improved = false;
+	for (int from = 0; from < routes.size(); from++)
+	{
+		for (int i = 0; i < routes[from].size(); i++)
+		{
+			double gain = removalGain(depot, routes[from], i);
+			const GeoCoord& stop = routes[from][i].location;
+			int bestRoute = -1;
+			int bestPosition = -1;
+			double bestCost = gain - MIN_GAIN;
+			for (int to = 0; to < routes.size(); to++)
+			{
+				if (to == from || routes[to].size() >= capacities[to])
+					continue;
+				for (int p = 0; p <= routes[to].size(); p++)	//insert before position p
+				{
+					const GeoCoord& prev = stopAt(depot, routes[to], p - 1);
+					const GeoCoord& next = stopAt(depot, routes[to], p);
+					double cost = distanceEarthMiles(prev, stop) + distanceEarthMiles(stop, next) - distanceEarthMiles(prev, next);
+					if (cost < bestCost)
+					{
+						bestCost = cost;
+						bestRoute = to;
+						bestPosition = p;
+					}
+				}
+			}
+			if (bestRoute != -1)
+			{
+				routes[bestRoute].insert(routes[bestRoute].begin() + bestPosition, routes[from][i]);
+				routes[from].erase(routes[from].begin() + i);
+				i--;
+				improved = true;
+			}
+		}
+	}
+	return improved;
+}
+
+//swap pairs of stops between vehicles; neither vehicle's load changes
+bool FleetPlannerImpl::exchange(const GeoCoord& depot, vector<vector<DeliveryRequest>>& routes) const
+{
+	bool improved = false;
+	for (int a = 0; a < routes.size(); a++)
+	{
+		for (int b = a + 1; b < routes.size(); b++)
+		{
+			for (int i = 0; i < routes[a].size(); i++)
+			{
+				for (int j = 0; j < routes[b].size(); j++)
+				{
+					double delta = replacementCost(depot, routes[a], i, routes[b][j].location)
+						+ replacementCost(depot, routes[b], j, routes[a][i].location);
+					if (delta < -MIN_GAIN)
+					{
+						swap(routes[a][i], routes[b][j]);
+						improved = true;
+					}
+				}
+			}
+		}
+	}
+	return improved;
+}
+
+//******************** FleetPlanner functions *********************************
+
+// These functions simply delegate to FleetPlannerImpl's functions.
+
+FleetPlanner::FleetPlanner(const StreetMap* sm, int numWorkers)
+{
+    m_impl = new FleetPlannerImpl(sm, numWorkers);
+}
+
+FleetPlanner::~FleetPlanner()
+{
+    delete m_impl;
+}
+
+DeliveryResult FleetPlanner::generateFleetPlan(
+    const GeoCoord& depot,
+    const vector<DeliveryRequest>& deliveries,
+    int numVehicles,
+    const vector<int>& capacities,
+    vector<vector<DeliveryCommand>>& commands,
+    vector<double>& distances,
+    double& totalDistanceTravelled) const
+{
+    return m_impl->generateFleetPlan(depot, deliveries, numVehicles, capacities, commands, distances, totalDistanceTravelled);
+}
@@ -0,0 +1,40 @@
+// FleetPlanner.h
+
+// Plans deliveries for several vehicles that all leave from and return to one depot.
+// Stops are split among the vehicles by sweeping around the depot, stops are moved and
+// swapped between vehicles while that shortens the fleet's total distance, and then the
+// vehicles' orders are optimized and routed in parallel on a bounded number of threads.
+#ifndef FLEETPLANNER_INCLUDED
+#define FLEETPLANNER_INCLUDED
+
+#include <vector>
+#include "provided.h"
+
+class FleetPlannerImpl;
+
+class FleetPlanner
+{
+public:
+      // numWorkers threads at most; 0 uses one per core
+    FleetPlanner(const StreetMap* sm, int numWorkers = 0);
+    ~FleetPlanner();
+      // capacities holds the most deliveries each vehicle can carry; vehicles past the
+      // end of it (all of them, if it is empty) have no limit.  commands and distances
+      // get one entry per vehicle, and a vehicle with nothing to deliver gets no
+      // commands.  Returns NO_ROUTE if some stop can't be reached or the vehicles can't
+      // carry every delivery between them.
+    DeliveryResult generateFleetPlan(
+        const GeoCoord& depot,
+        const std::vector<DeliveryRequest>& deliveries,
+        int numVehicles,
+        const std::vector<int>& capacities,
+        std::vector<std::vector<DeliveryCommand>>& commands,
+        std::vector<double>& distances,
+        double& totalDistanceTravelled) const;
+    FleetPlanner(const FleetPlanner&) = delete;
+    FleetPlanner& operator=(const FleetPlanner&) = delete;
+private:
+    FleetPlannerImpl* m_impl;
+};
+
+#endif // FLEETPLANNER_INCLUDED
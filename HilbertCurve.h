@@ -0,0 +1,48 @@
+// HilbertCurve.h
+
+// Position of a point along a Hilbert curve laid over a bounding box.  Points that are
+// close on the curve are close on the map, so sorting by this key groups nearby
+// coordinates together.
+#ifndef HILBERTCURVE_INCLUDED
+#define HILBERTCURVE_INCLUDED
+
+#include <algorithm>
+
+  // the box is split into a 2^16 x 2^16 grid; a point outside it is keyed as the nearest
+  // point on its edge
+inline unsigned long long hilbertIndex(double lat, double lon,
+    double minLat, double maxLat, double minLon, double maxLon)
+{
+    const unsigned int side = 1u << 16;
+    double latSpan = maxLat - minLat;
+    double lonSpan = maxLon - minLon;
+    unsigned int x = 0;
+    unsigned int y = 0;
+    //clamped before the cast, which is undefined for a negative or too large value
+    if (lonSpan > 0)
+        x = (unsigned int)std::min(std::max(0.0, (lon - minLon) / lonSpan * (side - 1)), double(side - 1));
+    if (latSpan > 0)
+        y = (unsigned int)std::min(std::max(0.0, (lat - minLat) / latSpan * (side - 1)), double(side - 1));
+
+    unsigned long long d = 0;
+    for (unsigned int s = side / 2; s > 0; s /= 2)
+    {
+        unsigned int rx = (x & s) > 0;
+        unsigned int ry = (y & s) > 0;
+        d += (unsigned long long)s * s * ((3 * rx) ^ ry);
+        if (ry == 0)    //rotate the quadrant so the curve stays continuous
+        {
+            if (rx == 1)
+            {
+                x = side - 1 - x;
+                y = side - 1 - y;
+            }
+            unsigned int t = x;
+            x = y;
+            y = t;
+        }
+    }
+    return d;
+}
+
+#endif // HILBERTCURVE_INCLUDED
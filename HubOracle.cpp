@@ -0,0 +1,205 @@
+#include "provided.h"
+#include "HubOracle.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+using namespace std;
+
+//identifies a hub file, and which version of the layout it uses
+const uint32_t HUB_FILE_MAGIC = 0x31425548;	//"HUB1"
+
+HubOracle::HubOracle()
+{
+	m_nodeCount = 0;
+	m_edgeCount = 0;
+	m_graphChecksum = 0;
+}
+
+bool HubOracle::build(const StreetGraph& graph, const vector<GeoCoord>& hubs)
+{
+	for (int n = 0; n < graph.nodeCount(); n++)
+		if (graph.firstEdge(n + 1) - graph.firstEdge(n) >= NO_PARENT)
+			return false;
+	m_hubNodes.clear();
+	for (int i = 0; i < hubs.size(); i++)
+	{
+		int node = graph.findNode(hubs[i]);
+		if (node == -1)
+			return false;
+		m_hubNodes.push_back(node);
+	}
+	m_nodeCount = graph.nodeCount();
+	m_edgeCount = graph.edgeCount();
+	m_graphChecksum = graph.checksum();
+	m_parents.assign(hubs.size(), vector<unsigned char>());
+	m_distances.assign(hubs.size(), vector<unsigned int>());
+
+	//each tree only writes its own hub's arrays
+	vector<char> built(hubs.size(), false);
+	parallelFor(hubs.size(), [&](int hub) { built[hub] = buildTree(graph, hub); });
+	return find(built.begin(), built.end(), false) == built.end();
+}
+
+//Dijkstra from the hub over edge lengths
+bool HubOracle::buildTree(const StreetGraph& graph, int hub)
+{
+	int numNodes = graph.nodeCount();
+	vector<double> distances(numNodes, HUGE_VAL);
+	vector<int> edgeTo(numNodes, -1);
+	vector<char> closed(numNodes, false);
+	vector<pair<double, int>> openLocations;
+	greater<pair<double, int>> later;
+	int start = m_hubNodes[hub];
+	distances[start] = 0;
+	openLocations.push_back(make_pair(0.0, start));
+	while (!openLocations.empty())
+	{
+		pop_heap(openLocations.begin(), openLocations.end(), later);
+		int current = openLocations.back().second;
+		openLocations.pop_back();
+		if (closed[current])
+			continue;
+		closed[current] = true;
+		for (int e = graph.firstEdge(current); e < graph.firstEdge(current + 1); e++)
+		{
+			int next = graph.edgeTarget(e);
+			double d = distances[current] + graph.edgeLength(e);
+			if (!closed[next] && d < distances[next])
+			{
+				distances[next] = d;
+				edgeTo[next] = e;
+				openLocations.push_back(make_pair(d, next));
+				push_heap(openLocations.begin(), openLocations.end(), later);
+			}
+		}
+	}
+
+	vector<unsigned char>& parents = m_parents[hub];
+	vector<unsigned int>& fixedDistances = m_distances[hub];
+	parents.assign(numNodes, NO_PARENT);
+	fixedDistances.assign(numNodes, NO_DISTANCE);
+	for (int n = 0; n < numNodes; n++)
+	{
+		if (isinf(distances[n]))
+			continue;
+		double scaled = round(distances[n] * DISTANCE_SCALE);
+		if (scaled >= NO_DISTANCE)
+			return false;
+		fixedDistances[n] = scaled;
+		if (n == start)
+			continue;
+		int back = graph.reverseEdge(edgeTo[n]);	//store the way back up the tree, which leaves n
+		if (back == -1)
+			return false;
+		parents[n] = back - graph.firstEdge(n);
+	}
+	return true;
+}
+
+bool HubOracle::save(string file) const
+{
+	ofstream outf(file, ios::binary);
+	if (!outf)
+		return false;
+	auto put = [&outf](const void* data, size_t size) { outf.write(static_cast<const char*>(data), size); };
+	uint32_t header[4] = { HUB_FILE_MAGIC, (uint32_t)m_nodeCount, (uint32_t)m_edgeCount, (uint32_t)m_hubNodes.size() };
+	put(header, sizeof(header));
+	put(&m_graphChecksum, sizeof(m_graphChecksum));
+	for (int hub = 0; hub < m_hubNodes.size(); hub++)
+	{
+		uint32_t node = m_hubNodes[hub];
+		put(&node, sizeof(node));
+	}
+	for (int hub = 0; hub < m_hubNodes.size(); hub++)
+	{
+		put(m_parents[hub].data(), m_nodeCount);
+		put(m_distances[hub].data(), m_nodeCount * sizeof(unsigned int));
+	}
+	return bool(outf);
+}
+
+bool HubOracle::load(string file, const StreetGraph& graph)
+{
+	ifstream inf(file, ios::binary);
+	if (!inf)
+		return false;
+	auto get = [&inf](void* data, size_t size) { return bool(inf.read(static_cast<char*>(data), size)); };
+	uint32_t header[4];
+	unsigned long long checksum = 0;
+	if (!get(header, sizeof(header)) || !get(&checksum, sizeof(checksum)))
+		return false;
+	if (header[0] != HUB_FILE_MAGIC || header[1] != graph.nodeCount() || header[2] != graph.edgeCount()
+		|| checksum != graph.checksum())
+		return false;
+
+	int numHubs = header[3];
+	vector<int> hubNodes(numHubs);
+	for (int hub = 0; hub < numHubs; hub++)
+	{
+		uint32_t node = 0;
+		if (!get(&node, sizeof(node)) || node >= graph.nodeCount())
+			return false;
+		hubNodes[hub] = node;
+	}
+	vector<vector<unsigned char>> parents(numHubs, vector<unsigned char>(graph.nodeCount()));
+	vector<vector<unsigned int>> distances(numHubs, vector<unsigned int>(graph.nodeCount()));
+	for (int hub = 0; hub < numHubs; hub++)
+	{
+		if (!get(parents[hub].data(), graph.nodeCount()) || !get(distances[hub].data(), graph.nodeCount() * sizeof(unsigned int)))
+			return false;
+	}
+
+	m_hubNodes.swap(hubNodes);
+	m_parents.swap(parents);
+	m_distances.swap(distances);
+	m_nodeCount = graph.nodeCount();
+	m_edgeCount = graph.edgeCount();
+	m_graphChecksum = checksum;
+	return true;
+}
+
+int HubOracle::hubIndex(int node) const
+{
+	for (int hub = 0; hub < m_hubNodes.size(); hub++)	//there are only ever a handful
+		if (m_hubNodes[hub] == node)
+			return hub;
+	return -1;
+}
+
+double HubOracle::distance(int hub, int node) const
+{
+	unsigned int fixed = m_distances[hub][node];
+	if (fixed == NO_DISTANCE)
+		return HUGE_VAL;
+	return (double)fixed / DISTANCE_SCALE;
+}
+
+bool HubOracle::routeToHub(const StreetGraph& graph, int hub, int node, EdgeRoute& edges) const
+{
+	edges.clear();
+	if (m_distances[hub][node] == NO_DISTANCE)
+		return false;
+	const vector<unsigned char>& parents = m_parents[hub];
+	for (int current = node; current != m_hubNodes[hub]; )	//climb the tree
+	{
+		int e = graph.firstEdge(current) + parents[current];
+		edges.push_back(e);
+		current = graph.edgeTarget(e);
+	}
+	return true;
+}
+
+bool HubOracle::routeFromHub(const StreetGraph& graph, int hub, int node, EdgeRoute& edges) const
+{
+	if (!routeToHub(graph, hub, node, edges))
+		return false;
+	reverse(edges.begin(), edges.end());
+	for (int i = 0; i < edges.size(); i++)
+		edges[i] = graph.reverseEdge(edges[i]);
+	return true;
+}
@@ -0,0 +1,64 @@
+// HubOracle.h
+
+// Shortest path trees from a few hubs (depots) to every node of a StreetGraph, built
+// ahead of time and kept on disk, so that a route starting or ending at a hub is read
+// off a tree instead of searched for.  Every road can be driven both ways for the same
+// distance, so one tree per hub answers legs both from and to it.
+//
+// A hub costs five bytes a node.  The edge back toward the hub is stored as its offset
+// from the node's firstEdge, which fits in a byte, and the distance from the hub is
+// stored in fixed point.  The trees assume every edge costs its length, so searchRoute
+// stops using them once edge weights have been changed.
+#ifndef HUBORACLE_INCLUDED
+#define HUBORACLE_INCLUDED
+
+#include <string>
+#include <vector>
+#include "provided.h"
+#include "StreetGraph.h"
+#include "RouteSearch.h"
+
+class HubOracle
+{
+public:
+	HubOracle();
+
+	  // one Dijkstra search per hub, all run in parallel; false if a hub is not on the
+	  // map or some node has too many edges to code in a byte
+	bool build(const StreetGraph& graph, const std::vector<GeoCoord>& hubs);
+	bool save(std::string file) const;
+	  // false if the file can't be read or was built from some other graph
+	bool load(std::string file, const StreetGraph& graph);
+
+	int hubCount() const { return m_hubNodes.size(); }
+	int hubNode(int hub) const { return m_hubNodes[hub]; }
+	  // the hub at node, or -1 if there is none
+	int hubIndex(int node) const;
+	  // miles from the hub to node, to within a small fraction of an inch; HUGE_VAL if
+	  // there is no way there
+	double distance(int hub, int node) const;
+
+	  // set edges to the route between the hub and node in the direction asked for;
+	  // false if there is none
+	bool routeFromHub(const StreetGraph& graph, int hub, int node, EdgeRoute& edges) const;
+	bool routeToHub(const StreetGraph& graph, int hub, int node, EdgeRoute& edges) const;
+
+private:
+	static constexpr unsigned char NO_PARENT = 255;
+	static constexpr unsigned int NO_DISTANCE = 0xffffffff;
+	//fixed point distances count in units of 1 / DISTANCE_SCALE miles
+	static constexpr int DISTANCE_SCALE = 1 << 16;
+
+	std::vector<int> m_hubNodes;
+	//hub : node : offset from firstEdge(node) of the edge toward the hub
+	std::vector<std::vector<unsigned char>> m_parents;
+	//hub : node : fixed point distance from the hub
+	std::vector<std::vector<unsigned int>> m_distances;
+	int m_nodeCount;
+	int m_edgeCount;
+	unsigned long long m_graphChecksum;
+
+	bool buildTree(const StreetGraph& graph, int hub);
+};
+
+#endif // HUBORACLE_INCLUDED
@@ -0,0 +1,311 @@
+#include "provided.h"
+#include "IncrementalPlan.h"
+#include "PlanBuilder.h"
+#include "RouteSearch.h"
+#include "MapSnapshot.h"
+#include <algorithm>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+using namespace std;
+
+//the route and commands for driving to one stop, or back to the depot for the last leg
+struct PlanLeg
+{
+	EdgeRoute edges;
+	double distance;
+	vector<DeliveryCommand> commands;
+};
+
+class IncrementalPlanImpl
+{
+public:
+    IncrementalPlanImpl(const StreetMap* sm);
+    ~IncrementalPlanImpl();
+    DeliveryResult start(const GeoCoord& depot, const vector<DeliveryRequest>& deliveries);
+    DeliveryResult insertStop(const DeliveryRequest& delivery, PlanEdit& edit);
+    DeliveryResult removeStop(int position, PlanEdit& edit);
+    const vector<DeliveryRequest>& deliveries() const;
+    void getCommands(vector<DeliveryCommand>& commands) const;
+    double totalDistance() const;
+private:
+	const StreetMap* m_streetMap;
+	DeliveryOptimizer* m_optimizer;
+	shared_ptr<const MapSnapshot> m_map;
+	RouteScratch* m_scratch;
+	GeoCoord m_depot;
+	vector<DeliveryRequest> m_stops;
+	//leg i ends at m_stops[i]; there is one more leg than stops
+	vector<PlanLeg> m_legs;
+	double m_totalDistance;
+
+	const GeoCoord& stopAt(int i) const;
+	DeliveryResult routeLeg(int leg, PlanLeg& result) const;
+	void repairAround(int center, int& firstLeg, int& lastLeg, vector<int>& swaps);
+	DeliveryResult replaceLegs(int firstLeg, int lastLeg, int legsAdded, PlanEdit& edit);
+	void undoSwaps(const vector<int>& swaps);
+};
+
+//the number of stops on either side of an edit that local repair may reorder
+const int REPAIR_WINDOW = 2;
+
+IncrementalPlanImpl::IncrementalPlanImpl(const StreetMap* sm)
+{
+	m_streetMap = sm;
+	m_optimizer = new DeliveryOptimizer(sm);
+	m_scratch = nullptr;
+	m_totalDistance = 0;
+}
+
+IncrementalPlanImpl::~IncrementalPlanImpl()
+{
+	delete m_scratch;
+	delete m_optimizer;
+}
+
+DeliveryResult IncrementalPlanImpl::start(const GeoCoord& depot, const vector<DeliveryRequest>& deliveries)
+{
+	shared_ptr<const MapSnapshot> map = m_streetMap->getSnapshot();
+	if (map == nullptr)
+		return BAD_COORD;
+	DeliveryResult validation = validateDeliveries(*map->graph, depot, deliveries);
+	if (validation != DELIVERY_SUCCESS)
+		return validation;
+
+	m_map = map;
+	delete m_scratch;
+	m_scratch = new RouteScratch(*m_map->graph);	//sized to this map and reused by every edit
+	m_depot = depot;
+	m_stops = deliveries;
+	double oldDist = 0;
+	double newDist = 0;
+	m_optimizer->optimizeDeliveryOrder(depot, m_stops, oldDist, newDist);
+
+	m_legs.clear();
+	m_legs.resize(m_stops.size() + 1);
+	m_totalDistance = 0;
+	for (int i = 0; i < m_legs.size(); i++)
+	{
+		DeliveryResult result = routeLeg(i, m_legs[i]);
+		if (result != DELIVERY_SUCCESS)
+		{
+			//a closed road can cut off a stop the component labels still join, so no
+			//plan is left for edits to patch
+			m_map = nullptr;
+			m_stops.clear();
+			m_legs.clear();
+			m_totalDistance = 0;
+			return result;
+		}
+		m_totalDistance += m_legs[i].distance;
+	}
+	return DELIVERY_SUCCESS;
+}
+
+//cheapest insertion by straight line distance, then route only the legs that changed
+DeliveryResult IncrementalPlanImpl::insertStop(const DeliveryRequest& delivery, PlanEdit& edit)
+{
+	if (m_map == nullptr)
+		return BAD_COORD;
+	const StreetGraph& graph = *m_map->graph;
+	int node = graph.findNode(delivery.location);
+	if (node == -1)
+		return BAD_COORD;
+	if (graph.component(node) != graph.component(graph.findNode(m_depot)))
+		return NO_ROUTE;
+
+	int bestPosition = 0;
+	double bestCost = 0;
+	for (int p = 0; p <= m_stops.size(); p++)	//insert before position p
+	{
+		const GeoCoord& prev = stopAt(p - 1);
+		const GeoCoord& next = stopAt(p);
+		double cost = distanceEarthMiles(prev, delivery.location) + distanceEarthMiles(delivery.location, next)
+			- distanceEarthMiles(prev, next);
+		if (p == 0 || cost < bestCost)
+		{
+			bestCost = cost;
+			bestPosition = p;
+		}
+	}
+
+	//the leg into the new stop and the leg out of it replace the leg that used to pass by
+	m_stops.insert(m_stops.begin() + bestPosition, delivery);
+	int firstLeg = bestPosition;
+	int lastLeg = bestPosition + 1;
+	vector<int> swaps;
+	repairAround(bestPosition, firstLeg, lastLeg, swaps);
+	DeliveryResult result = replaceLegs(firstLeg, lastLeg, 1, edit);
+	if (result != DELIVERY_SUCCESS)
+	{
+		undoSwaps(swaps);
+		m_stops.erase(m_stops.begin() + bestPosition);
+	}
+	return result;
+}
+
+DeliveryResult IncrementalPlanImpl::removeStop(int position, PlanEdit& edit)
+{
+	if (position < 0 || position >= m_stops.size())
+		return BAD_COORD;
+
+	//one leg straight from the previous stop to the next replaces the two through this one
+	DeliveryRequest removed = m_stops[position];
+	m_stops.erase(m_stops.begin() + position);
+	int firstLeg = position;
+	int lastLeg = position;
+	vector<int> swaps;
+	repairAround(position, firstLeg, lastLeg, swaps);
+	DeliveryResult result = replaceLegs(firstLeg, lastLeg, -1, edit);
+	if (result != DELIVERY_SUCCESS)
+	{
+		undoSwaps(swaps);
+		m_stops.insert(m_stops.begin() + position, removed);
+	}
+	return result;
+}
+
+const vector<DeliveryRequest>& IncrementalPlanImpl::deliveries() const
+{
+	return m_stops;
+}
+
+void IncrementalPlanImpl::getCommands(vector<DeliveryCommand>& commands) const
+{
+	commands.clear();
+	for (int i = 0; i < m_legs.size(); i++)
+		commands.insert(commands.end(), m_legs[i].commands.begin(), m_legs[i].commands.end());
+}
+
+double IncrementalPlanImpl::totalDistance() const
+{
+	return m_totalDistance;
+}
+
+//stop i of the tour, where the depot is both stop -1 and the stop after the last
+const GeoCoord& IncrementalPlanImpl::stopAt(int i) const
+{
+	if (i < 0 || i >= m_stops.size())
+		return m_depot;
+	return m_stops[i].location;
+}
+
+DeliveryResult IncrementalPlanImpl::routeLeg(int leg, PlanLeg& result) const
+{
+	const StreetGraph& graph = *m_map->graph;
+	int start = graph.findNode(stopAt(leg - 1));
+	int end = graph.findNode(stopAt(leg));
+	DeliveryResult routed = searchRoute(*m_map, start, end, result.edges, result.distance, *m_scratch);
+	if (routed != DELIVERY_SUCCESS)
+		return routed;
+	result.commands.clear();
+	CommandListSink sink(result.commands);
+	describeLeg(graph, result.edges, leg < m_stops.size() ? &m_stops[leg] : nullptr, sink);
+	return DELIVERY_SUCCESS;
+}
+
+//swap neighbouring stops near an edit while that shortens the tour; every leg touched by a
+//swap joins the range of legs to reroute
+void IncrementalPlanImpl::repairAround(int center, int& firstLeg, int& lastLeg, vector<int>& swaps)
+{
+	int first = max(0, center - REPAIR_WINDOW);
+	int last = min((int)m_stops.size() - 2, center + REPAIR_WINDOW - 1);
+	for (int k = first; k <= last; k++)
+	{
+		const GeoCoord& prev = stopAt(k - 1);
+		const GeoCoord& next = stopAt(k + 2);
+		const GeoCoord& a = m_stops[k].location;
+		const GeoCoord& b = m_stops[k + 1].location;
+		if (distanceEarthMiles(prev, b) + distanceEarthMiles(a, next) < distanceEarthMiles(prev, a) + distanceEarthMiles(b, next))
+		{
+			swap(m_stops[k], m_stops[k + 1]);
+			swaps.push_back(k);
+			firstLeg = min(firstLeg, k);
+			lastLeg = max(lastLeg, k + 2);
+		}
+	}
+}
+
+void IncrementalPlanImpl::undoSwaps(const vector<int>& swaps)
+{
+	for (int i = swaps.size() - 1; i >= 0; i--)
+		swap(m_stops[swaps[i]], m_stops[swaps[i] + 1]);
+}
+
+//m_stops already holds the new order; legs firstLeg..lastLeg of it are routed again and
+//replace the old legs over the same stretch, which had legsAdded fewer legs
+DeliveryResult IncrementalPlanImpl::replaceLegs(int firstLeg, int lastLeg, int legsAdded, PlanEdit& edit)
+{
+	vector<PlanLeg> newLegs(lastLeg - firstLeg + 1);
+	for (int i = 0; i < newLegs.size(); i++)
+	{
+		DeliveryResult result = routeLeg(firstLeg + i, newLegs[i]);
+		if (result != DELIVERY_SUCCESS)
+			return result;
+	}
+
+	edit.firstCommand = 0;
+	for (int i = 0; i < firstLeg; i++)
+		edit.firstCommand += m_legs[i].commands.size();
+	edit.removedCommands = 0;
+	edit.insertedCommands.clear();
+	int lastOldLeg = lastLeg - legsAdded;
+	for (int i = firstLeg; i <= lastOldLeg; i++)
+	{
+		edit.removedCommands += m_legs[i].commands.size();
+		m_totalDistance -= m_legs[i].distance;
+	}
+	for (int i = 0; i < newLegs.size(); i++)
+	{
+		edit.insertedCommands.insert(edit.insertedCommands.end(), newLegs[i].commands.begin(), newLegs[i].commands.end());
+		m_totalDistance += newLegs[i].distance;
+	}
+
+	m_legs.erase(m_legs.begin() + firstLeg, m_legs.begin() + lastOldLeg + 1);
+	m_legs.insert(m_legs.begin() + firstLeg, make_move_iterator(newLegs.begin()), make_move_iterator(newLegs.end()));
+	return DELIVERY_SUCCESS;
+}
+
+//******************** IncrementalPlan functions ******************************
+
+// These functions simply delegate to IncrementalPlanImpl's functions.
+
+IncrementalPlan::IncrementalPlan(const StreetMap* sm)
+{
+    m_impl = new IncrementalPlanImpl(sm);
+}
+
+IncrementalPlan::~IncrementalPlan()
+{
+    delete m_impl;
+}
+
+DeliveryResult IncrementalPlan::start(const GeoCoord& depot, const vector<DeliveryRequest>& deliveries)
+{
+    return m_impl->start(depot, deliveries);
+}
+
+DeliveryResult IncrementalPlan::insertStop(const DeliveryRequest& delivery, PlanEdit& edit)
+{
+    return m_impl->insertStop(delivery, edit);
+}
+
+DeliveryResult IncrementalPlan::removeStop(int position, PlanEdit& edit)
+{
+    return m_impl->removeStop(position, edit);
+}
+
+const vector<DeliveryRequest>& IncrementalPlan::deliveries() const
+{
+    return m_impl->deliveries();
+}
+
+void IncrementalPlan::getCommands(vector<DeliveryCommand>& commands) const
+{
+    m_impl->getCommands(commands);
+}
+
+double IncrementalPlan::totalDistance() const
+{
+    return m_impl->totalDistance();
+}
@@ -0,0 +1,48 @@
+// IncrementalPlan.h
+
+// A delivery plan that can be edited after it is made.  It keeps the order of the stops
+// and the route and commands of every leg, so adding or cancelling a stop only routes
+// and describes the few legs next to it instead of planning everything again.
+//
+// A plan keeps using the version of the map it was started on; call start again to
+// plan against a newer one.
+#ifndef INCREMENTALPLAN_INCLUDED
+#define INCREMENTALPLAN_INCLUDED
+
+#include <vector>
+#include "provided.h"
+
+  // What an edit did to the plan's command list: the removedCommands commands starting
+  // at firstCommand were replaced with insertedCommands.
+struct PlanEdit
+{
+    int firstCommand;
+    int removedCommands;
+    std::vector<DeliveryCommand> insertedCommands;
+};
+
+class IncrementalPlanImpl;
+
+class IncrementalPlan
+{
+public:
+    IncrementalPlan(const StreetMap* sm);
+    ~IncrementalPlan();
+      // plan from scratch the way DeliveryPlanner does and remember the result
+    DeliveryResult start(const GeoCoord& depot, const std::vector<DeliveryRequest>& deliveries);
+      // add a stop where it lengthens the tour least, then tidy up the stops around it
+    DeliveryResult insertStop(const DeliveryRequest& delivery, PlanEdit& edit);
+      // cancel the stop at this position of deliveries(); returns BAD_COORD if there is none
+    DeliveryResult removeStop(int position, PlanEdit& edit);
+
+      // the stops in the order they will be delivered
+    const std::vector<DeliveryRequest>& deliveries() const;
+    void getCommands(std::vector<DeliveryCommand>& commands) const;
+    double totalDistance() const;
+    IncrementalPlan(const IncrementalPlan&) = delete;
+    IncrementalPlan& operator=(const IncrementalPlan&) = delete;
+private:
+    IncrementalPlanImpl* m_impl;
+};
+
+#endif // INCREMENTALPLAN_INCLUDED
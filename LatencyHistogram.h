@@ -0,0 +1,98 @@
+// LatencyHistogram.h
+
+// Fixed size histogram of latencies in microseconds.  Buckets split every power of two
+// into eight, so percentiles are reported to within 12.5% without keeping every sample.
+// Not thread safe; callers that share one must lock around it.
+#ifndef LATENCYHISTOGRAM_INCLUDED
+#define LATENCYHISTOGRAM_INCLUDED
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <string>
+#include <vector>
+
+class LatencyHistogram
+{
+public:
+    LatencyHistogram()
+     : m_counts(NUM_BUCKETS, 0), m_count(0), m_total(0), m_max(0)
+    {}
+
+    void record(double micros)
+    {
+        m_counts[bucketOf(micros)]++;
+        m_count++;
+        m_total += micros;
+        if (micros > m_max)
+            m_max = micros;
+    }
+
+    void merge(const LatencyHistogram& other)
+    {
+        for (int i = 0; i < NUM_BUCKETS; i++)
+            m_counts[i] += other.m_counts[i];
+        m_count += other.m_count;
+        m_total += other.m_total;
+        if (other.m_max > m_max)
+            m_max = other.m_max;
+    }
+
+    long long count() const { return m_count; }
+    double mean() const { return m_count == 0 ? 0 : m_total / m_count; }
+    double max() const { return m_max; }
+
+      // upper edge of the bucket holding the given fraction (0-1) of samples
+    double percentile(double fraction) const
+    {
+        long long wanted = (long long)std::ceil(fraction * m_count);
+        long long seen = 0;
+        for (int i = 0; i < NUM_BUCKETS; i++)
+        {
+            seen += m_counts[i];
+            if (seen >= wanted && seen > 0)
+                return std::min(bucketUpper(i), m_max);
+        }
+        return m_max;
+    }
+
+    std::string summary() const
+    {
+        std::ostringstream oss;
+        oss.setf(std::ios::fixed);
+        oss.precision(1);
+        oss << "count=" << m_count << " mean_us=" << mean() << " p50_us=" << percentile(0.5)
+            << " p90_us=" << percentile(0.9) << " p99_us=" << percentile(0.99) << " max_us=" << m_max;
+        return oss.str();
+    }
+
+private:
+    static const int SUB_BUCKETS = 8;
+    static const int NUM_BUCKETS = 1 + 40 * SUB_BUCKETS;
+    std::vector<long long> m_counts;
+    long long m_count;
+    double m_total;
+    double m_max;
+
+    static int bucketOf(double micros)
+    {
+        if (micros < 1)
+            return 0;
+        int exponent;
+        double fraction = std::frexp(micros, &exponent);   // micros = fraction * 2^exponent, fraction in [0.5, 1)
+        int sub = (int)((fraction * 2 - 1) * SUB_BUCKETS);
+        int bucket = 1 + (exponent - 1) * SUB_BUCKETS + sub;
+        return bucket < NUM_BUCKETS ? bucket : NUM_BUCKETS - 1;
+    }
+
+    static double bucketUpper(int bucket)
+    {
+        if (bucket == 0)
+            return 1;
+        int exponent = (bucket - 1) / SUB_BUCKETS;
+        int sub = (bucket - 1) % SUB_BUCKETS;
+        return std::ldexp(1 + (sub + 1) / (double)SUB_BUCKETS, exponent);
+    }
+};
+
+#endif // LATENCYHISTOGRAM_INCLUDED
@@ -0,0 +1,223 @@
+#include "provided.h"
+#include "ManifestReader.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+using namespace std;
+
+//files smaller than this are parsed on one thread; each chunk is at least this big
+const size_t MIN_CHUNK_BYTES = 1 << 20;
+
+//the whole of a file, mapped read only where the system allows it and read into memory otherwise
+class MappedFile
+{
+public:
+	MappedFile() : m_data(nullptr), m_size(0), m_mapped(false) {}
+	~MappedFile();
+	bool open(const string& file);
+	string_view text() const { return string_view(m_data, m_size); }
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+private:
+	const char* m_data;
+	size_t m_size;
+	bool m_mapped;
+	string m_copy;
+};
+
+bool MappedFile::open(const string& file)
+{
+#if defined(__unix__) || defined(__APPLE__)
+	int fd = ::open(file.c_str(), O_RDONLY);
+	if (fd == -1)
+		return false;
+	struct stat info;
+	if (fstat(fd, &info) == 0 && info.st_size > 0)
+	{
+		void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data != MAP_FAILED)
+		{
+			madvise(data, info.st_size, MADV_SEQUENTIAL);
+			m_data = static_cast<const char*>(data);
+			m_size = info.st_size;
+			m_mapped = true;
+			::close(fd);
+			return true;
+		}
+	}
+	::close(fd);	//empty, or not mappable (a pipe, say); read it the ordinary way
+#endif
+	ifstream inf(file, ios::binary);
+	if (!inf)
+		return false;
+	m_copy.assign(istreambuf_iterator<char>(inf), istreambuf_iterator<char>());
+	m_data = m_copy.data();
+	m_size = m_copy.size();
+	return true;
+}
+
+MappedFile::~MappedFile()
+{
+#if defined(__unix__) || defined(__APPLE__)
+	if (m_mapped)
+		munmap(const_cast<char*>(m_data), m_size);
+#endif
+}
+
+//the next whitespace separated token of text at or after pos, or an empty view
+string_view nextToken(string_view text, size_t& pos)
+{
+	while (pos < text.size() && isspace((unsigned char)text[pos]))
+		pos++;
+	size_t start = pos;
+	while (pos < text.size() && !isspace((unsigned char)text[pos]))
+		pos++;
+	return text.substr(start, pos - start);
+}
+
+bool parseNumber(string_view token, double& value)
+{
+	const char* end = token.data() + token.size();
+	from_chars_result parsed = from_chars(token.data(), end, value);
+	return !token.empty() && parsed.ec == errc() && parsed.ptr == end;
+}
+
+//a coord straight from the text of its two numbers, without parsing them twice
+bool parseCoord(string_view text, GeoCoord& gc)
+{
+	size_t pos = 0;
+	string_view lat = nextToken(text, pos);
+	string_view lon = nextToken(text, pos);
+	double latitude = 0;
+	double longitude = 0;
+	if (!parseNumber(lat, latitude) || !parseNumber(lon, longitude))
+		return false;
+	gc.latitudeText.assign(lat);
+	gc.longitudeText.assign(lon);
+	gc.latitude = latitude;
+	gc.longitude = longitude;
+	return true;
+}
+
+//the deliveries and errors of a run of whole lines; line numbers start at 0 within the run
+struct ManifestChunk
+{
+	string_view text;
+	vector<DeliveryRequest> deliveries;
+	vector<ManifestError> errors;
+	int lineCount;
+};
+
+void parseChunk(ManifestChunk& chunk)
+{
+	string_view text = chunk.text;
+	chunk.lineCount = 0;
+	size_t start = 0;
+	while (start < text.size())
+	{
+		size_t newline = text.find('\n', start);
+		if (newline == string_view::npos)
+			newline = text.size();
+		string_view line = text.substr(start, newline - start);
+		start = newline + 1;
+		int lineNumber = chunk.lineCount++;
+		if (!line.empty() && line.back() == '\r')
+			line.remove_suffix(1);
+
+		size_t colon = line.find(':');
+		if (colon == string_view::npos)
+		{
+			chunk.errors.push_back(ManifestError{ lineNumber, "Missing colon in deliveries file line: " + string(line) });
+			continue;
+		}
+		GeoCoord location;
+		if (!parseCoord(line.substr(0, colon), location))
+		{
+			chunk.errors.push_back(ManifestError{ lineNumber, "Bad format in deliveries file line: " + string(line) });
+			continue;
+		}
+		if (colon + 1 == line.size())
+		{
+			chunk.errors.push_back(ManifestError{ lineNumber, "Missing item in deliveries file line: " + string(line) });
+			continue;
+		}
+		chunk.deliveries.emplace_back(string(line.substr(colon + 1)), location);
+	}
+}
+
+ManifestReader::ManifestReader()
+{
+}
+
+bool ManifestReader::read(string deliveriesFile, int maxThreads)
+{
+	m_depot = GeoCoord();
+	m_deliveries.clear();
+	m_errors.clear();
+	MappedFile file;
+	if (!file.open(deliveriesFile))
+		return false;
+	string_view text = file.text();
+
+	size_t depotEnd = text.find('\n');
+	if (depotEnd == string_view::npos)
+		depotEnd = text.size();
+	if (!parseCoord(text.substr(0, depotEnd), m_depot))
+		return false;
+	string_view body = text.substr(min(depotEnd + 1, text.size()));
+
+	//cut the body into chunks that each end just after a line break
+	if (maxThreads <= 0)
+		maxThreads = max(1u, thread::hardware_concurrency());
+	int numChunks = max<size_t>(1, min<size_t>(maxThreads, body.size() / MIN_CHUNK_BYTES));
+	vector<ManifestChunk> chunks(numChunks);
+	size_t start = 0;
+	for (int c = 0; c < numChunks; c++)
+	{
+		size_t end = body.size();
+		if (c + 1 < numChunks)
+		{
+			end = body.find('\n', max(start, body.size() / numChunks * (c + 1)));
+			end = end == string_view::npos ? body.size() : end + 1;
+		}
+		chunks[c].text = body.substr(start, end - start);
+		start = end;
+	}
+	parallelFor(numChunks, [&](int c) { parseChunk(chunks[c]); }, maxThreads);
+
+	size_t total = 0;
+	for (int c = 0; c < numChunks; c++)
+		total += chunks[c].deliveries.size();
+	m_deliveries.reserve(total);
+	int firstLine = 2;	//the line after the depot
+	for (int c = 0; c < numChunks; c++)
+	{
+		m_deliveries.insert(m_deliveries.end(), make_move_iterator(chunks[c].deliveries.begin()), make_move_iterator(chunks[c].deliveries.end()));
+		for (int i = 0; i < chunks[c].errors.size(); i++)
+		{
+			m_errors.push_back(std::move(chunks[c].errors[i]));
+			m_errors.back().line += firstLine;
+		}
+		firstLine += chunks[c].lineCount;
+	}
+	return true;
+}
+
+void ManifestReader::writeErrors(ostream& out) const
+{
+	for (int i = 0; i < m_errors.size(); i++)
+		out << m_errors[i].message << '\n';
+}
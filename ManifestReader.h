@@ -0,0 +1,48 @@
+// ManifestReader.h
+
+// Reads a deliveries file: a depot line "lat lon" followed by one "lat lon:item" line
+// per delivery.  The file is mapped into memory and each line is split in place, so the
+// only strings built are the ones a DeliveryRequest keeps.  Big files are split at line
+// breaks into chunks parsed on several threads.  Lines that can't be parsed are left out
+// and collected in a report instead of being printed as they are found.
+#ifndef MANIFESTREADER_INCLUDED
+#define MANIFESTREADER_INCLUDED
+
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "provided.h"
+
+struct ManifestError
+{
+	int line;	//counting the depot line as line 1
+	std::string message;
+};
+
+class ManifestReader
+{
+public:
+	ManifestReader();
+	  // returns false if the file can't be read or has no valid depot line; lines that
+	  // can't be parsed don't fail the read.  maxThreads is 0 for one per core.
+	bool read(std::string deliveriesFile, int maxThreads = 1);
+
+	const GeoCoord& depot() const { return m_depot; }
+	  // the deliveries in file order, to hand straight to a planner or move out
+	std::vector<DeliveryRequest>& deliveries() { return m_deliveries; }
+	const std::vector<ManifestError>& errors() const { return m_errors; }
+	  // every error on its own line, in file order
+	void writeErrors(std::ostream& out) const;
+
+private:
+	GeoCoord m_depot;
+	std::vector<DeliveryRequest> m_deliveries;
+	std::vector<ManifestError> m_errors;
+};
+
+  // a coord from text starting with its latitude and longitude, both numbers as from_chars
+  // reads them; false if they aren't.  Anything after the two numbers is ignored.
+bool parseCoord(std::string_view text, GeoCoord& gc);
+
+#endif // MANIFESTREADER_INCLUDED
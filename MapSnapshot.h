@@ -0,0 +1,27 @@
+// MapSnapshot.h
+
+// One published version of a StreetMap.  StreetMap::load builds a new snapshot off to
+// the side and swaps it in atomically; a route or plan takes the current snapshot when
+// it starts and holds it until it finishes, so it never sees a map change underneath
+// it.  A snapshot is freed when the last call using it lets go.
+#ifndef MAPSNAPSHOT_INCLUDED
+#define MAPSNAPSHOT_INCLUDED
+
+#include <memory>
+#include "StreetGraph.h"
+#include "EdgeWeights.h"
+
+class HubOracle;
+
+struct MapSnapshot
+{
+	std::shared_ptr<const StreetGraph> graph;
+	  // travel cost multipliers for graph's edges; a new load starts them all at 1
+	std::shared_ptr<const EdgeWeights> weights;
+	  // shortest path trees from the hubs, if StreetMap::loadHubs was given some for graph
+	std::shared_ptr<const HubOracle> hubs;
+	  // increases by one each time a load or a batch of edge weights is published
+	unsigned long version;
+};
+
+#endif // MAPSNAPSHOT_INCLUDED
@@ -0,0 +1,40 @@
+// Parallel.h
+
+// A minimal way to spread independent pieces of work over the machine's cores.
+#ifndef PARALLEL_INCLUDED
+#define PARALLEL_INCLUDED
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+
+  // how many threads parallelFor runs count tasks on, given the same maxThreads
+inline int workerCount(int count, int maxThreads = 0)
+{
+	if (maxThreads <= 0)
+		maxThreads = std::max(1u, std::thread::hardware_concurrency());
+	return std::min(count, maxThreads);
+}
+
+  // run task(0) through task(count - 1), each exactly once, on up to maxThreads threads
+  // (one per core if it is 0); returns when all of them have finished
+inline void parallelFor(int count, const std::function<void(int)>& task, int maxThreads = 0)
+{
+	int numThreads = workerCount(count, maxThreads);
+	std::atomic<int> next(0);
+	auto worker = [&]()
+	{
+		for (int i = next++; i < count; i = next++)
+			task(i);
+	};
+	std::vector<std::thread> threads;
+	for (int t = 1; t < numThreads; t++)
+		threads.push_back(std::thread(worker));
+	worker();
+	for (int t = 0; t < threads.size(); t++)
+		threads[t].join();
+}
+
+#endif // PARALLEL_INCLUDED
@@ -0,0 +1,70 @@
+// PlanBuilder.h
+
+// The steps DeliveryPlanner goes through, for planners that choose the order of the
+// deliveries some other way and only need them checked, routed and turned into commands.
+#ifndef PLANBUILDER_INCLUDED
+#define PLANBUILDER_INCLUDED
+
+#include <vector>
+#include <memory_resource>
+#include "provided.h"
+#include "MapSnapshot.h"
+#include "RouteSearch.h"
+
+  // A sink that appends the commands to a vector.
+class CommandListSink : public DeliveryCommandSink
+{
+public:
+    CommandListSink(std::vector<DeliveryCommand>& commands) : m_commands(commands) {}
+    void receive(const DeliveryCommand& command) { m_commands.push_back(command); }
+private:
+    std::vector<DeliveryCommand>& m_commands;
+};
+
+  // A finished plan kept compactly: the order the stops are delivered in, as indices into
+  // the manifest, and the edges driven on each leg.  describePlan turns it back into
+  // exactly the commands it was made from, with no ordering or routing.
+struct CompactPlan
+{
+    double totalDistanceTravelled;
+    std::vector<int> order;
+      // the edges of every leg one after another; leg i starts at legStarts[i], and there
+      // is one more entry for the end of the last leg
+    std::vector<int> edges;
+    std::vector<int> legStarts;
+};
+
+  // BAD_COORD if the depot or a delivery isn't on the map, otherwise NO_ROUTE if a
+  // delivery can't be reached from the depot
+DeliveryResult validateDeliveries(const StreetGraph& graph, const GeoCoord& depot,
+    const std::vector<DeliveryRequest>& deliveries);
+
+  // route a tour from depot through deliveries in the order given and back, and turn it
+  // into proceed, turn and deliver commands; the stops should already be validated.
+  // Returns CANCELLED if cancel isn't null and is cancelled partway.  If compact isn't
+  // null its edges and legStarts get the route driven.
+DeliveryResult buildDeliveryPlan(const MapSnapshot& map, const GeoCoord& depot,
+    const std::vector<DeliveryRequest>& deliveries, std::vector<DeliveryCommand>& commands,
+    double& totalDistanceTravelled, const CancellationToken* cancel = nullptr, CompactPlan* compact = nullptr);
+
+  // the same, but each leg's commands go to sink as soon as it is routed and the memory
+  // used does not grow with the number of stops (unless compact is asked for); on
+  // failure the earlier legs' commands have already been sent
+DeliveryResult streamDeliveryPlan(const MapSnapshot& map, const GeoCoord& depot,
+    const std::vector<DeliveryRequest>& deliveries, DeliveryCommandSink& sink,
+    double& totalDistanceTravelled, const CancellationToken* cancel = nullptr, CompactPlan* compact = nullptr);
+
+  // send the commands of a plan made on this graph for these deliveries
+void describePlan(const StreetGraph& graph, const std::vector<DeliveryRequest>& deliveries,
+    const CompactPlan& plan, DeliveryCommandSink& sink);
+
+  // send the proceed and turn commands for driving one leg of a tour, then the deliver
+  // command for delivery, the stop at the end of the leg (nullptr for the leg that
+  // returns to the depot)
+void describeLeg(const StreetGraph& graph, const EdgeRoute& edges,
+    const DeliveryRequest* delivery, DeliveryCommandSink& sink);
+
+  // identifies the settings DeliveryOptimizer orders stops with
+unsigned long long optimizerSettingsChecksum();
+
+#endif // PLANBUILDER_INCLUDED
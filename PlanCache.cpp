@@ -0,0 +1,308 @@
+#include "provided.h"
+#include "PlanCache.h"
+#include "ByteBuffer.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <functional>
+#include <vector>
+using namespace std;
+
+//identifies a cached plan file, and which version of the layout it uses
+const uint32_t PLAN_FILE_MAGIC = 0x31434c50;	//"PLC1"
+//rough cost of keeping an entry besides its key and plan: the entry, table slot, vectors
+const size_t ENTRY_OVERHEAD_BYTES = 160;
+
+//FNV-1a
+unsigned long long planHash(const char* bytes, size_t size, unsigned long long hash = 14695981039346656037ULL)
+{
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= (unsigned char)bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+//plan hashes are already well mixed, so folding them in half keeps that
+unsigned int hasher(const unsigned long long& hash)
+{
+	return (unsigned int)(hash ^ hash >> 32);
+}
+
+PlanCache::PlanCache(size_t maxBytes)
+{
+	m_maxBytes = maxBytes;
+	m_bytes = 0;
+	m_useCount = 0;
+	m_hits = 0;
+	m_diskHits = 0;
+	m_misses = 0;
+}
+
+bool PlanCache::openDirectory(string directory)
+{
+	error_code error;
+	filesystem::create_directories(directory, error);
+	if (!filesystem::is_directory(directory, error))
+		return false;
+	lock_guard<mutex> lock(m_mutex);
+	m_directory = directory;
+	return true;
+}
+
+//the graph's checksum mixed with every edge's multiplier, worked out once per version of the
+//map rather than once per plan, since it reads the whole graph
+unsigned long long PlanCache::mapIdentity(const MapSnapshot& map)
+{
+	shared_ptr<const MapIdentity> last = atomic_load(&m_mapIdentity);
+	if (last != nullptr && last->graph.lock() == map.graph && last->weights.lock() == map.weights)
+		return last->identity;
+	unsigned long long identity = map.graph->checksum();
+	if (!map.weights->unchanged())
+	{
+		for (int e = 0; e < map.graph->edgeCount(); e++)
+		{
+			double multiplier = map.weights->multiplier(e);
+			identity = planHash(reinterpret_cast<const char*>(&multiplier), sizeof(multiplier), identity);
+		}
+	}
+	shared_ptr<MapIdentity> worked = make_shared<MapIdentity>();
+	worked->graph = map.graph;
+	worked->weights = map.weights;
+	worked->identity = identity;
+	atomic_store(&m_mapIdentity, shared_ptr<const MapIdentity>(worked));
+	return identity;
+}
+
+string PlanCache::makeKey(const MapSnapshot& map, const GeoCoord& depot, const vector<DeliveryRequest>& deliveries)
+{
+	ByteWriter key;
+	key.put<uint64_t>(mapIdentity(map));
+	key.put<uint64_t>(optimizerSettingsChecksum());
+	key.putText(depot.latitudeText, true);
+	key.putText(depot.longitudeText, true);
+	key.put<uint32_t>(deliveries.size());
+	for (int i = 0; i < deliveries.size(); i++)
+	{
+		key.putText(deliveries[i].location.latitudeText, true);
+		key.putText(deliveries[i].location.longitudeText, true);
+		key.putText(deliveries[i].item, true);
+	}
+	return key.bytes();
+}
+
+string PlanCache::fileName(unsigned long long hash) const
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.plan", hash);
+	return m_directory + "/" + name;
+}
+
+bool PlanCache::find(const MapSnapshot& map, const GeoCoord& depot, const vector<DeliveryRequest>& deliveries,
+	CompactPlan& plan)
+{
+	string key = makeKey(map, depot, deliveries);
+	unsigned long long hash = planHash(key.data(), key.size());
+	shared_ptr<Entry> found;
+	if (m_entries.find(hash, found) && found->key == key)	//an entry's key and plan never change once stored
+	{
+		found->lastUsed = ++m_useCount;
+		plan = found->plan;
+		m_hits++;
+		return true;
+	}
+	string directory;
+	{
+		lock_guard<mutex> lock(m_mutex);
+		directory = m_directory;
+	}
+	//the file is read without holding the lock, so other plans aren't held up by the disk
+	if (directory == "" || !readFile(hash, key, plan) || !fits(plan, map, deliveries))
+	{
+		m_misses++;
+		return false;
+	}
+	m_diskHits++;
+	lock_guard<mutex> lock(m_mutex);
+	remember(hash, key, plan);
+	return true;
+}
+
+void PlanCache::store(const MapSnapshot& map, const GeoCoord& depot, const vector<DeliveryRequest>& deliveries,
+	const CompactPlan& plan)
+{
+	string key = makeKey(map, depot, deliveries);
+	unsigned long long hash = planHash(key.data(), key.size());
+	string directory;
+	{
+		lock_guard<mutex> lock(m_mutex);
+		remember(hash, key, plan);
+		directory = m_directory;
+	}
+	if (directory != "")
+		writeFile(hash, key, plan);
+}
+
+void PlanCache::remember(unsigned long long hash, const string& key, const CompactPlan& plan)
+{
+	size_t bytes = ENTRY_OVERHEAD_BYTES + key.size()
+		+ sizeof(int) * (plan.order.size() + plan.edges.size() + plan.legStarts.size());
+	if (bytes > m_maxBytes)	//would push out everything else
+		return;
+	shared_ptr<Entry> entry = make_shared<Entry>();
+	entry->hash = hash;
+	entry->key = key;
+	entry->plan = plan;
+	entry->bytes = bytes;
+	entry->lastUsed = ++m_useCount;
+
+	shared_ptr<Entry> old;
+	if (m_entries.find(hash, old))	//replace the plan, or one whose hash collides with it
+	{
+		m_bytes -= old->bytes;
+		m_stored[old->slot] = m_stored.back();
+		m_stored[old->slot]->slot = old->slot;
+		m_stored.pop_back();
+	}
+	if (m_bytes + bytes > m_maxBytes)
+		makeRoom(bytes);
+	entry->slot = m_stored.size();
+	m_stored.push_back(entry);
+	m_entries.associate(hash, entry);
+	m_bytes += bytes;
+}
+
+//finding a plan only marks when it was used, so the least recently used are found by
+//sorting; freeing a quarter of the cache at a time keeps that to once per many stores
+void PlanCache::makeRoom(size_t bytesNeeded)
+{
+	size_t target = min(m_maxBytes - bytesNeeded, m_maxBytes / 4 * 3);
+	//sorted on a copy of the times, since lookups can mark entries used meanwhile
+	vector<pair<long long, int>> byUse(m_stored.size());	//last used, slot
+	for (int i = 0; i < m_stored.size(); i++)
+		byUse[i] = make_pair(m_stored[i]->lastUsed.load(), i);
+	sort(byUse.begin(), byUse.end());
+	vector<bool> dropped(m_stored.size(), false);
+	for (int i = 0; i < byUse.size() && m_bytes > target; i++)
+	{
+		const shared_ptr<Entry>& entry = m_stored[byUse[i].second];
+		m_bytes -= entry->bytes;
+		m_entries.remove(entry->hash);
+		dropped[byUse[i].second] = true;
+	}
+	int kept = 0;
+	for (int i = 0; i < m_stored.size(); i++)
+	{
+		if (dropped[i])
+			continue;
+		m_stored[kept] = m_stored[i];
+		m_stored[kept]->slot = kept;
+		kept++;
+	}
+	m_stored.resize(kept);
+}
+
+//a damaged file could name edges or stops that aren't there
+bool PlanCache::fits(const CompactPlan& plan, const MapSnapshot& map, const vector<DeliveryRequest>& deliveries)
+{
+	if (plan.legStarts.size() != deliveries.size() + 2 || plan.order.size() != deliveries.size()
+		|| plan.legStarts.front() != 0 || plan.legStarts.back() != plan.edges.size())
+		return false;
+	for (int i = 0; i + 1 < plan.legStarts.size(); i++)
+		if (plan.legStarts[i] > plan.legStarts[i + 1])
+			return false;
+	for (int i = 0; i < plan.order.size(); i++)
+		if (plan.order[i] < 0 || plan.order[i] >= deliveries.size())
+			return false;
+	for (int i = 0; i < plan.edges.size(); i++)
+		if (plan.edges[i] < 0 || plan.edges[i] >= map.graph->edgeCount())
+			return false;
+	return true;
+}
+
+//a file holds the magic number, the key, and the plan
+bool PlanCache::readFile(unsigned long long hash, const string& key, CompactPlan& plan) const
+{
+	ifstream inf(fileName(hash), ios::binary);
+	if (!inf)
+		return false;
+	string bytes((istreambuf_iterator<char>(inf)), istreambuf_iterator<char>());
+	ByteReader reader(bytes);
+	uint32_t magic = 0;
+	string storedKey;
+	if (!reader.get(magic) || magic != PLAN_FILE_MAGIC || !reader.getText(storedKey, true) || storedKey != key)
+		return false;
+	auto getInts = [&reader](vector<int>& values)
+	{
+		uint32_t count = 0;
+		if (!reader.get(count))
+			return false;
+		values.resize(count);
+		for (uint32_t i = 0; i < count; i++)
+			if (!reader.get(values[i]))
+				return false;
+		return true;
+	};
+	return reader.get(plan.totalDistanceTravelled) && getInts(plan.order) && getInts(plan.edges)
+		&& getInts(plan.legStarts) && reader.atEnd();
+}
+
+void PlanCache::writeFile(unsigned long long hash, const string& key, const CompactPlan& plan) const
+{
+	ByteWriter writer;
+	writer.put<uint32_t>(PLAN_FILE_MAGIC);
+	writer.putText(key, true);
+	writer.put(plan.totalDistanceTravelled);
+	auto putInts = [&writer](const vector<int>& values)
+	{
+		writer.put<uint32_t>(values.size());
+		for (int i = 0; i < values.size(); i++)
+			writer.put<int32_t>(values[i]);
+	};
+	putInts(plan.order);
+	putInts(plan.edges);
+	putInts(plan.legStarts);
+
+	//written beside the real name and renamed into place, so a reader in this or another
+	//process never sees half a file
+	string name = fileName(hash);
+	string partial = name + "." + to_string(std::hash<thread::id>()(this_thread::get_id()) ^ reinterpret_cast<uintptr_t>(this)) + ".tmp";
+	bool written;
+	{
+		ofstream outf(partial, ios::binary | ios::trunc);
+		written = bool(outf.write(writer.bytes().data(), writer.bytes().size()));
+	}
+	error_code error;
+	if (written)
+		filesystem::rename(partial, name, error);
+	if (!written || error)
+		filesystem::remove(partial, error);
+}
+
+long long PlanCache::hits() const
+{
+	return m_hits;
+}
+
+long long PlanCache::diskHits() const
+{
+	return m_diskHits;
+}
+
+long long PlanCache::misses() const
+{
+	return m_misses;
+}
+
+size_t PlanCache::bytes() const
+{
+	lock_guard<mutex> lock(m_mutex);
+	return m_bytes;
+}
@@ -0,0 +1,107 @@
+// PlanCache.h
+
+// Remembers finished delivery plans so a manifest planned before, a recurring route or a
+// retry after a client gave up, is answered without ordering or routing it again.  A
+// DeliveryPlanner given a cache looks every manifest up before planning it and stores
+// every plan it completes.
+//
+// Plans are found by the map they were made on (its graph checksum and edge weights),
+// the optimizer's settings, the depot, and the deliveries in the order given; any change
+// to one of these is a different plan.  Each plan is kept as a CompactPlan, the stop
+// order and the edges driven, which takes a few bytes per edge against the strings of
+// a command list, and is described back into commands when found.
+//
+// The cache holds at most a set number of bytes in memory; once it is full the least
+// recently used plans are dropped until a quarter of it is free again.  Given a
+// directory it also keeps every plan in a file there, so plans survive the process; a
+// plan missing from memory is looked for on disk.
+//
+// Plans in memory are indexed by a ConcurrentHashMap, so finding one only shares a lock
+// with other lookups in the same segment.  Storing and dropping plans take one lock.
+#ifndef PLANCACHE_INCLUDED
+#define PLANCACHE_INCLUDED
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "provided.h"
+#include "MapSnapshot.h"
+#include "PlanBuilder.h"
+#include "ConcurrentHashMap.h"
+
+class PlanCache
+{
+public:
+	PlanCache(size_t maxBytes = 64 << 20);
+	  // also keep plans in files in directory, creating it if need be, and find the plans
+	  // an earlier process left there; false if the directory can't be made
+	bool openDirectory(std::string directory);
+
+	  // true, filling plan, if a plan for this manifest on this map is cached
+	bool find(const MapSnapshot& map, const GeoCoord& depot, const std::vector<DeliveryRequest>& deliveries,
+		CompactPlan& plan);
+	void store(const MapSnapshot& map, const GeoCoord& depot, const std::vector<DeliveryRequest>& deliveries,
+		const CompactPlan& plan);
+
+	long long hits() const;
+	long long diskHits() const;
+	long long misses() const;
+	  // memory held by the plans in memory, in bytes
+	size_t bytes() const;
+
+	PlanCache(const PlanCache&) = delete;
+	PlanCache& operator=(const PlanCache&) = delete;
+
+private:
+	struct Entry
+	{
+		unsigned long long hash;
+		  // everything the plan was found by, so plans whose hashes collide are told apart
+		std::string key;
+		CompactPlan plan;
+		size_t bytes;
+		  // m_useCount when the plan was last stored or found
+		std::atomic<long long> lastUsed;
+		  // where the entry is in m_stored
+		int slot;
+	};
+	  // the graph and weights whose identity was worked out last, and that identity; weak
+	  // so an old map is not kept in memory once nothing else uses it
+	struct MapIdentity
+	{
+		std::weak_ptr<const StreetGraph> graph;
+		std::weak_ptr<const EdgeWeights> weights;
+		unsigned long long identity;
+	};
+
+	  // guards m_bytes, m_directory and m_stored; finding a plan in memory doesn't take it
+	mutable std::mutex m_mutex;
+	size_t m_maxBytes;
+	size_t m_bytes;
+	std::string m_directory;
+	  // every entry in memory, in no order; only the thread holding m_mutex changes it
+	std::vector<std::shared_ptr<Entry>> m_stored;
+
+	ConcurrentHashMap<unsigned long long, std::shared_ptr<Entry>> m_entries;
+	std::shared_ptr<const MapIdentity> m_mapIdentity;
+	std::atomic<long long> m_useCount;
+	std::atomic<long long> m_hits;
+	std::atomic<long long> m_diskHits;
+	std::atomic<long long> m_misses;
+
+	unsigned long long mapIdentity(const MapSnapshot& map);
+	std::string makeKey(const MapSnapshot& map, const GeoCoord& depot, const std::vector<DeliveryRequest>& deliveries);
+	std::string fileName(unsigned long long hash) const;
+	static bool fits(const CompactPlan& plan, const MapSnapshot& map, const std::vector<DeliveryRequest>& deliveries);
+	bool readFile(unsigned long long hash, const std::string& key, CompactPlan& plan) const;
+	void writeFile(unsigned long long hash, const std::string& key, const CompactPlan& plan) const;
+	  // keep a plan in memory, making room for it; the caller holds m_mutex
+	void remember(unsigned long long hash, const std::string& key, const CompactPlan& plan);
+	  // drop the plans used least recently until a quarter of the cache is free, or
+	  // bytesNeeded is, whichever is more; the caller holds m_mutex
+	void makeRoom(size_t bytesNeeded);
+};
+
+#endif // PLANCACHE_INCLUDED
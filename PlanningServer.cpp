@@ -0,0 +1,262 @@
+#include "provided.h"
+#include "PlanningServer.h"
+#include "LatencyHistogram.h"
+#include "MapSnapshot.h"
+#include "ManifestReader.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+using namespace std;
+
+//private to this file, so it can never clash with another PlanJob in the program
+namespace
+{
+struct PlanJob
+{
+	string id;
+	bool wellFormed;
+	GeoCoord depot;
+	vector<DeliveryRequest> deliveries;
+	chrono::steady_clock::time_point received;
+};
+}
+
+class PlanningServerImpl
+{
+public:
+    PlanningServerImpl(StreetMap* sm, int numWorkers, int maxQueued, PlanCache* cache);
+    ~PlanningServerImpl();
+    void serve(istream& requests, ostream& responses);
+    string stats() const;
+private:
+	StreetMap* m_streetMap;
+	PlanCache* m_cache;
+	int m_numWorkers;
+	int m_maxQueued;
+
+	//jobs read but not yet picked up by a worker
+	deque<PlanJob*> m_queue;
+	bool m_inputDone;
+	mutex m_queueMutex;
+	condition_variable m_jobReady;
+	condition_variable m_slotFree;
+
+	ostream* m_responses;
+	mutex m_outputMutex;
+
+	LatencyHistogram m_latencies;
+	mutable mutex m_statsMutex;
+
+	PlanJob* readJob(istream& requests, const string& header);
+	void enqueue(PlanJob* job);
+	void work();
+	void reload(string mapFile);
+};
+
+const char* statusName(DeliveryResult result);
+
+PlanningServerImpl::PlanningServerImpl(StreetMap* sm, int numWorkers, int maxQueued, PlanCache* cache)
+{
+	m_streetMap = sm;
+	m_cache = cache;
+	m_numWorkers = numWorkers < 1 ? 1 : numWorkers;
+	m_maxQueued = maxQueued < 1 ? 1 : maxQueued;
+	m_inputDone = false;
+	m_responses = nullptr;
+}
+
+PlanningServerImpl::~PlanningServerImpl()
+{
+}
+
+void PlanningServerImpl::serve(istream& requests, ostream& responses)
+{
+	m_responses = &responses;
+	m_inputDone = false;
+	vector<thread> workers;
+	vector<thread> reloaders;
+	for (int i = 0; i < m_numWorkers; i++)
+		workers.push_back(thread(&PlanningServerImpl::work, this));
+
+	string line;
+	while (getline(requests, line))
+	{
+		if (line.empty())
+			continue;
+		if (line == "STATS")
+		{
+			string summary = stats();
+			lock_guard<mutex> lock(m_outputMutex);
+			responses << "STATS " << summary << endl;
+			continue;
+		}
+		if (line.compare(0, 7, "RELOAD ") == 0)
+		{
+			reloaders.push_back(thread(&PlanningServerImpl::reload, this, line.substr(7)));
+			continue;
+		}
+		enqueue(readJob(requests, line));	//blocks while the queue is full, which stops us reading more input
+	}
+
+	{
+		lock_guard<mutex> lock(m_queueMutex);
+		m_inputDone = true;
+	}
+	m_jobReady.notify_all();
+	for (int i = 0; i < workers.size(); i++)	//let the workers drain the queue
+		workers[i].join();
+	for (int i = 0; i < reloaders.size(); i++)
+		reloaders[i].join();
+}
+
+//runs on its own thread; workers keep planning against the old map until the new one is published
+void PlanningServerImpl::reload(string mapFile)
+{
+	bool loaded = m_streetMap->load(mapFile);
+	ostringstream oss;
+	if (loaded)
+		oss << "RELOADED " << m_streetMap->getSnapshot()->version << "\n";
+	else
+		oss << "RELOAD_FAILED " << mapFile << "\n";
+	lock_guard<mutex> lock(m_outputMutex);
+	*m_responses << oss.str() << flush;
+}
+
+string PlanningServerImpl::stats() const
+{
+	lock_guard<mutex> lock(m_statsMutex);
+	return m_latencies.summary();
+}
+
+//read a request whose header line has already been read
+PlanJob* PlanningServerImpl::readJob(istream& requests, const string& header)
+{
+	PlanJob* job = new PlanJob;
+	job->received = chrono::steady_clock::now();
+	job->wellFormed = false;
+
+	istringstream iss(header);
+	string keyword;
+	int numDeliveries = -1;
+	iss >> keyword >> job->id >> numDeliveries;
+	if (keyword != "PLAN" || numDeliveries < 0)
+		return job;
+
+	string line;
+	if (!getline(requests, line) || !parseCoord(line, job->depot))
+		return job;
+	bool allParsed = true;
+	for (int i = 0; i < numDeliveries; i++)	//read every line of the request even if one is bad, so the next request starts in the right place
+	{
+		if (!getline(requests, line))
+			return job;
+		const size_t colon = line.find(':');
+		GeoCoord location;
+		if (colon == string::npos || colon + 1 == line.size() || !parseCoord(string_view(line).substr(0, colon), location))
+		{
+			allParsed = false;
+			continue;
+		}
+		job->deliveries.push_back(DeliveryRequest(line.substr(colon + 1), location));
+	}
+	job->wellFormed = allParsed;
+	return job;
+}
+
+//the status word a response gives for a plan's result
+const char* statusName(DeliveryResult result)
+{
+	switch (result)
+	{
+	case DELIVERY_SUCCESS: return "SUCCESS";
+	case NO_ROUTE: return "NO_ROUTE";
+	case BAD_COORD: return "BAD_COORD";
+	case CANCELLED: return "CANCELLED";
+	}
+	return "UNKNOWN";
+}
+
+void PlanningServerImpl::enqueue(PlanJob* job)
+{
+	unique_lock<mutex> lock(m_queueMutex);
+	m_slotFree.wait(lock, [this] { return m_queue.size() < m_maxQueued; });
+	m_queue.push_back(job);
+	lock.unlock();
+	m_jobReady.notify_one();
+}
+
+void PlanningServerImpl::work()
+{
+	DeliveryPlanner planner(m_streetMap, m_cache);
+	vector<DeliveryCommand> commands;
+	for (;;)
+	{
+		unique_lock<mutex> lock(m_queueMutex);
+		m_jobReady.wait(lock, [this] { return !m_queue.empty() || m_inputDone; });
+		if (m_queue.empty())	//input is done and nothing is left
+			return;
+		PlanJob* job = m_queue.front();
+		m_queue.pop_front();
+		lock.unlock();
+		m_slotFree.notify_one();
+
+		const char* status = "BAD_REQUEST";
+		double miles = 0;
+		commands.clear();
+		if (job->wellFormed)
+		{
+			DeliveryResult result = planner.generateDeliveryPlan(job->depot, job->deliveries, commands, miles);
+			status = statusName(result);
+		}
+
+		//format the whole response before taking the output lock
+		double latency = chrono::duration<double, micro>(chrono::steady_clock::now() - job->received).count();
+		ostringstream oss;
+		oss.setf(ios::fixed);
+		oss.precision(2);
+		oss << "RESULT " << job->id << " " << status << " " << commands.size() << " " << miles;
+		oss.precision(0);
+		oss << " " << latency << "\n";
+		for (int i = 0; i < commands.size(); i++)
+			oss << commands[i].description() << "\n";
+		{
+			lock_guard<mutex> outputLock(m_outputMutex);
+			*m_responses << oss.str() << flush;
+		}
+		{
+			lock_guard<mutex> statsLock(m_statsMutex);
+			m_latencies.record(latency);
+		}
+		delete job;
+	}
+}
+
+//******************** PlanningServer functions *******************************
+
+// These functions simply delegate to PlanningServerImpl's functions.
+
+PlanningServer::PlanningServer(StreetMap* sm, int numWorkers, int maxQueued, PlanCache* cache)
+{
+    m_impl = new PlanningServerImpl(sm, numWorkers, maxQueued, cache);
+}
+
+PlanningServer::~PlanningServer()
+{
+    delete m_impl;
+}
+
+void PlanningServer::serve(istream& requests, ostream& responses)
+{
+    m_impl->serve(requests, responses);
+}
+
+string PlanningServer::stats() const
+{
+    return m_impl->stats();
+}
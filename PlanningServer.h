@@ -0,0 +1,47 @@
+// PlanningServer.h
+
+// Keeps one loaded StreetMap resident and answers delivery plan requests read from a
+// stream, so a map only has to be loaded once for any number of plans.
+//
+// Each request is a header line followed by a deliveries file's worth of lines:
+//     PLAN <id> <number of deliveries>
+//     <depot latitude> <depot longitude>
+//     <latitude> <longitude>:<item>          (once per delivery)
+// and is answered, possibly out of order, with
+//     RESULT <id> <status> <number of commands> <miles> <latency in microseconds>
+//     <one command description per line>
+// where status is SUCCESS, NO_ROUTE, BAD_COORD, CANCELLED or BAD_REQUEST.  Coordinates
+// are read as ManifestReader reads a deliveries file.  A line reading STATS is answered
+// with a STATS line summarizing the latencies seen so far.
+//
+// A line reading RELOAD <map file> loads that map in the background and answers
+// RELOADED <map version> or RELOAD_FAILED <map file>.  Plans already running finish on
+// the map they started with; plans started after the new map is published use it.
+#ifndef PLANNINGSERVER_INCLUDED
+#define PLANNINGSERVER_INCLUDED
+
+#include <iostream>
+#include <string>
+#include "provided.h"
+
+class PlanningServerImpl;
+class PlanCache;
+
+class PlanningServer
+{
+public:
+      // plans run on numWorkers threads; once maxQueued requests are waiting, reading
+      // stops until a worker frees a slot.  Given a cache, repeated manifests are
+      // answered from it.
+    PlanningServer(StreetMap* sm, int numWorkers, int maxQueued, PlanCache* cache = nullptr);
+    ~PlanningServer();
+      // returns once requests is exhausted and every request read has been answered
+    void serve(std::istream& requests, std::ostream& responses);
+    std::string stats() const;
+    PlanningServer(const PlanningServer&) = delete;
+    PlanningServer& operator=(const PlanningServer&) = delete;
+private:
+    PlanningServerImpl* m_impl;
+};
+
+#endif // PLANNINGSERVER_INCLUDED
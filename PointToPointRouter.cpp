@@ -1,26 +1,77 @@
 #include "provided.h"
-#include "ExpandableHashMap.h"
+#include "RouteSearch.h"
+#include "MapSnapshot.h"
+#include "HubOracle.h"
+#include "TiledMap.h"
+#include "CompressedGraph.h"
+#include "QueryLog.h"
 #include <list>
-#include <queue>
+#include <unordered_map>
+#include <algorithm>
+#include <functional>
+#include <chrono>
+#include <climits>
+#include <memory>
+#include <cmath>
 using namespace std;
 
+//searches look at their cancellation token once every this many expanded nodes
+const int CANCEL_CHECK_INTERVAL = 256;
+
 class PointToPointRouterImpl
 {
 public:
     PointToPointRouterImpl(const StreetMap* sm);
+    PointToPointRouterImpl(const TiledMap* tm);
+    PointToPointRouterImpl(const CompressedGraph* cg);
     ~PointToPointRouterImpl();
     DeliveryResult generatePointToPointRoute(
         const GeoCoord& start,
         const GeoCoord& end,
         list<StreetSegment>& route,
         double& totalDistanceTravelled) const;
+    DeliveryResult generatePointToPointRoute(
+        const GeoCoord& start,
+        const GeoCoord& end,
+        double maxSuboptimality,
+        list<StreetSegment>& route,
+        double& totalDistanceTravelled,
+        RouteSearchStats& stats,
+        const CancellationToken* cancel) const;
 private:
+	//exactly one of these is set
 	const StreetMap* m_streetMap;
+	const TiledMap* m_tiledMap;
+	const CompressedGraph* m_compressedGraph;
+	DeliveryResult findRoute(const GeoCoord& start, const GeoCoord& end, double maxSuboptimality,
+		list<StreetSegment>& route, double& totalDistanceTravelled, RouteSearchStats& stats,
+		const CancellationToken* cancel) const;
 };
 
+DeliveryResult searchTiledRoute(const TiledMap& map, const GeoCoord& start, const GeoCoord& end, double weight,
+	list<StreetSegment>& route, double& totalDistanceTravelled, RouteSearchStats& stats, const CancellationToken* cancel);
+DeliveryResult searchCompressedRoute(const CompressedGraph& graph, const GeoCoord& start, const GeoCoord& end, double weight,
+	list<StreetSegment>& route, double& totalDistanceTravelled, RouteSearchStats& stats, const CancellationToken* cancel);
+
 PointToPointRouterImpl::PointToPointRouterImpl(const StreetMap* sm)
 {
 	m_streetMap = sm;
+	m_tiledMap = nullptr;
+	m_compressedGraph = nullptr;
+}
+
+PointToPointRouterImpl::PointToPointRouterImpl(const TiledMap* tm)
+{
+	m_streetMap = nullptr;
+	m_tiledMap = tm;
+	m_compressedGraph = nullptr;
+}
+
+PointToPointRouterImpl::PointToPointRouterImpl(const CompressedGraph* cg)
+{
+	m_streetMap = nullptr;
+	m_tiledMap = nullptr;
+	m_compressedGraph = cg;
 }
 
 PointToPointRouterImpl::~PointToPointRouterImpl()
@@ -28,97 +79,534 @@ PointToPointRouterImpl::~PointToPointRouterImpl()
 }
 
 
+RouteScratch::RouteScratch(const StreetGraph& graph, pmr::memory_resource* resource)
+	: RouteScratch(graph.nodeCount(), resource)
+{
+}
+
+RouteScratch::RouteScratch(int nodeCount, pmr::memory_resource* resource)
+	: openLocations(resource),
+	  m_costs(nodeCount, 0, resource),
+	  m_edges(nodeCount, -1, resource),
+	  m_stamps(nodeCount, 0, resource),
+	  m_stamp(1)
+{
+}
+
+void RouteScratch::reset()
+{
+	openLocations.clear();
+	if (m_stamp >= UINT_MAX - 2)	//stamps are about to wrap, so really clear them
+	{
+		fill(m_stamps.begin(), m_stamps.end(), 0);
+		m_stamp = 1;
+	}
+	else
+		m_stamp += 2;
+}
+
+void RouteScratch::reach(int node, double cost, int edge)
+{
+	m_stamps[node] = m_stamp;
+	m_costs[node] = cost;
+	m_edges[node] = edge;
+}
+
 //A* Star Implementation of Route Finding
+DeliveryResult searchRoute(const MapSnapshot& map, int start, int end,
+	EdgeRoute& edges, double& totalDistanceTravelled, RouteScratch& scratch,
+	double weight, RouteSearchStats* stats, const CancellationToken* cancel)
+{
+	const StreetGraph& graph = *map.graph;
+	const EdgeWeights& weights = *map.weights;
+	edges.clear();
+	totalDistanceTravelled = 0;
+	RouteSearchStats unused;
+	if (stats == nullptr)
+		stats = &unused;
+	*stats = RouteSearchStats();
+	if (start == end)	//if start is end, already at delivery location
+		return DELIVERY_SUCCESS;
+	if (graph.component(start) != graph.component(end))	//no road connects the two parts of the map, so don't bother searching
+		return NO_ROUTE;
+
+	//a leg to or from a hub is read off its shortest path tree, as long as the costs the
+	//tree was built with still hold
+	if (map.hubs != nullptr && weights.unchanged())
+	{
+		const HubOracle& hubs = *map.hubs;
+		int hub = hubs.hubIndex(start);
+		bool found = hub != -1 && hubs.routeFromHub(graph, hub, end, edges);
+		if (!found)
+		{
+			hub = hubs.hubIndex(end);
+			found = hub != -1 && hubs.routeToHub(graph, hub, start, edges);
+		}
+		if (found)
+		{
+			for (int i = 0; i < edges.size(); i++)
+				totalDistanceTravelled += graph.edgeLength(edges[i]);
+			return DELIVERY_SUCCESS;
+		}
+	}
+
+	const GeoCoord& endCoord = graph.coord(end);
+	//if some edges cost less than their length, shrink the estimate so it never overestimates
+	double heuristicScale = weights.minMultiplier();
+	//an inflated estimate can close a node before its cheapest way in is found, so then
+	//closed nodes are opened again when a cheaper way turns up
+	weight = max(weight, 1.0);
+	bool reopen = weight > 1;
+	pmr::vector<pair<double, int>>& openLocations = scratch.openLocations;
+	greater<pair<double, int>> later;
+	scratch.reset();
+	scratch.reach(start, 0, -1);
+	stats->nodesReached = 1;
+	openLocations.push_back(make_pair(0.0, start));
+	while (!openLocations.empty())
+	{
+		pop_heap(openLocations.begin(), openLocations.end(), later);
+		int current = openLocations.back().second;
+		openLocations.pop_back();
+		if (scratch.closed(current))	//a shorter way here was already processed
+			continue;
+		scratch.close(current);
+		stats->nodesExpanded++;
+		if (cancel != nullptr && stats->nodesExpanded % CANCEL_CHECK_INTERVAL == 0 && cancel->cancelled())
+			return CANCELLED;
+		if (current == end)	//if end found, walk the edges back to the start
+		{
+			for (int node = end; node != start; node = graph.edgeSource(scratch.edgeTo(node)))
+				edges.push_back(scratch.edgeTo(node));
+			reverse(edges.begin(), edges.end());
+			for (int i = 0; i < edges.size(); i++)
+				totalDistanceTravelled += graph.edgeLength(edges[i]);
+			if (reopen)
+			{
+				//some open node lies on a cheapest route with its cheapest cost, so the
+				//smallest unweighted f among them is a lower bound on the cheapest route
+				double lowerBound = HUGE_VAL;
+				for (int i = 0; i < openLocations.size(); i++)
+				{
+					int node = openLocations[i].second;
+					if (!scratch.closed(node))
+						lowerBound = min(lowerBound, scratch.cost(node) + heuristicScale * distanceEarthMiles(graph.coord(node), endCoord));
+				}
+				if (scratch.cost(end) > lowerBound)
+					stats->suboptimalityBound = min(weight, scratch.cost(end) / lowerBound);
+			}
+			return DELIVERY_SUCCESS;
+		}
+
+		//relax all connected edges
+		for (int e = graph.firstEdge(current); e < graph.firstEdge(current + 1); e++)
+		{
+			int next = graph.edgeTarget(e);
+			if (scratch.closed(next) && !reopen)
+				continue;
+			double multiplier = weights.multiplier(e);
+			if (isinf(multiplier))	//road is closed
+				continue;
+			// g is the total cost to get to the location
+			double g = scratch.cost(current) + graph.edgeLength(e) * multiplier;
+			//if this location has not yet been visited or is better than the previous route, process it
+			if (!scratch.reached(next) || g < scratch.cost(next))
+			{
+				if (!scratch.reached(next))
+					stats->nodesReached++;
+				scratch.reach(next, g, e);
+				// f = g + distance to end, scaled up by the weight for a quicker, looser search
+				double f = g + weight * heuristicScale * distanceEarthMiles(graph.coord(next), endCoord);
+				openLocations.push_back(make_pair(f, next));
+				push_heap(openLocations.begin(), openLocations.end(), later);
+			}
+		}
+	}
+	return NO_ROUTE;
+}
+
+void searchRoutesFrom(const MapSnapshot& map, int start, const vector<int>& ends,
+	vector<EdgeRoute>& routes, vector<double>& distances, vector<DeliveryResult>& results, RouteScratch& scratch)
+{
+	const StreetGraph& graph = *map.graph;
+	const EdgeWeights& weights = *map.weights;
+	routes.assign(ends.size(), EdgeRoute());
+	distances.assign(ends.size(), 0);
+	results.assign(ends.size(), NO_ROUTE);
+
+	//node : the destinations at it still to be reached; ones in another component never will be
+	unordered_map<int, vector<int>> waiting;
+	for (int i = 0; i < ends.size(); i++)
+		if (graph.component(ends[i]) == graph.component(start))
+			waiting[ends[i]].push_back(i);
+	pmr::vector<pair<double, int>>& openLocations = scratch.openLocations;
+	greater<pair<double, int>> later;
+	scratch.reset();
+	scratch.reach(start, 0, -1);
+	openLocations.push_back(make_pair(0.0, start));
+	while (!openLocations.empty() && !waiting.empty())
+	{
+		pop_heap(openLocations.begin(), openLocations.end(), later);
+		int current = openLocations.back().second;
+		openLocations.pop_back();
+		if (scratch.closed(current))
+			continue;
+		scratch.close(current);
+		auto arrived = waiting.find(current);
+		if (arrived != waiting.end())
+		{
+			for (int i = 0; i < arrived->second.size(); i++)
+				results[arrived->second[i]] = DELIVERY_SUCCESS;
+			waiting.erase(arrived);
+		}
+
+		for (int e = graph.firstEdge(current); e < graph.firstEdge(current + 1); e++)
+		{
+			int next = graph.edgeTarget(e);
+			if (scratch.closed(next))
+				continue;
+			double multiplier = weights.multiplier(e);
+			if (isinf(multiplier))	//road is closed
+				continue;
+			double g = scratch.cost(current) + graph.edgeLength(e) * multiplier;
+			if (!scratch.reached(next) || g < scratch.cost(next))
+			{
+				scratch.reach(next, g, e);
+				openLocations.push_back(make_pair(g, next));
+				push_heap(openLocations.begin(), openLocations.end(), later);
+			}
+		}
+	}
+
+	for (int i = 0; i < ends.size(); i++)	//walk each destination back to the start
+	{
+		if (results[i] != DELIVERY_SUCCESS)
+			continue;
+		EdgeRoute& edges = routes[i];
+		for (int node = ends[i]; node != start; node = graph.edgeSource(scratch.edgeTo(node)))
+			edges.push_back(scratch.edgeTo(node));
+		reverse(edges.begin(), edges.end());
+		for (int j = 0; j < edges.size(); j++)
+			distances[i] += graph.edgeLength(edges[j]);
+	}
+}
+
+void searchWithin(const MapSnapshot& map, int start, double maxDistance,
+	vector<int>& nodes, vector<double>& distances, RouteScratch& scratch)
+{
+	const StreetGraph& graph = *map.graph;
+	const EdgeWeights& weights = *map.weights;
+	nodes.clear();
+	distances.clear();
+	pmr::vector<pair<double, int>>& openLocations = scratch.openLocations;
+	greater<pair<double, int>> later;
+	scratch.reset();
+	scratch.reach(start, 0, -1);
+	openLocations.push_back(make_pair(0.0, start));
+	while (!openLocations.empty())
+	{
+		pop_heap(openLocations.begin(), openLocations.end(), later);
+		int current = openLocations.back().second;
+		openLocations.pop_back();
+		if (scratch.closed(current))
+			continue;
+		if (scratch.cost(current) > maxDistance)	//everything still open is further still
+			break;
+		scratch.close(current);
+		nodes.push_back(current);
+		distances.push_back(scratch.cost(current));
+
+		for (int e = graph.firstEdge(current); e < graph.firstEdge(current + 1); e++)
+		{
+			int next = graph.edgeTarget(e);
+			if (scratch.closed(next) || isinf(weights.multiplier(e)))
+				continue;
+			double g = scratch.cost(current) + graph.edgeLength(e);
+			if (!scratch.reached(next) || g < scratch.cost(next))
+			{
+				scratch.reach(next, g, e);
+				openLocations.push_back(make_pair(g, next));
+				push_heap(openLocations.begin(), openLocations.end(), later);
+			}
+		}
+	}
+}
+
 DeliveryResult PointToPointRouterImpl::generatePointToPointRoute(
         const GeoCoord& start,
         const GeoCoord& end,
         list<StreetSegment>& route,
         double& totalDistanceTravelled) const
+{
+	RouteSearchStats stats;
+	return generatePointToPointRoute(start, end, 1, route, totalDistanceTravelled, stats, nullptr);
+}
+
+DeliveryResult PointToPointRouterImpl::generatePointToPointRoute(
+        const GeoCoord& start,
+        const GeoCoord& end,
+        double maxSuboptimality,
+        list<StreetSegment>& route,
+        double& totalDistanceTravelled,
+        RouteSearchStats& stats,
+        const CancellationToken* cancel) const
+{
+	QueryLog* log = QueryLog::active();
+	chrono::steady_clock::time_point started;
+	if (log != nullptr)
+		started = chrono::steady_clock::now();
+	DeliveryResult result = findRoute(start, end, maxSuboptimality, route, totalDistanceTravelled, stats, cancel);
+	if (log != nullptr)
+		log->recordRoute(started, start, end, maxSuboptimality, result, totalDistanceTravelled);
+	return result;
+}
+
+DeliveryResult PointToPointRouterImpl::findRoute(const GeoCoord& start, const GeoCoord& end, double maxSuboptimality,
+	list<StreetSegment>& route, double& totalDistanceTravelled, RouteSearchStats& stats,
+	const CancellationToken* cancel) const
 {
 	route.clear();		//clear route
 	totalDistanceTravelled = 0;
-	if (start == end)	//if start is end, already at delivery location
-		return DELIVERY_SUCCESS;
-	vector<StreetSegment> containsStEnd;
-	if (!(m_streetMap->getSegmentsThatStartWith(start, containsStEnd)) || !(m_streetMap->getSegmentsThatStartWith(end, containsStEnd)))	//if start or end is not in map, it is a bad coord
+	stats = RouteSearchStats();
+	if (m_tiledMap != nullptr)
+		return searchTiledRoute(*m_tiledMap, start, end, maxSuboptimality, route, totalDistanceTravelled, stats, cancel);
+	if (m_compressedGraph != nullptr)
+		return searchCompressedRoute(*m_compressedGraph, start, end, maxSuboptimality, route, totalDistanceTravelled, stats, cancel);
+	//hold on to this version of the map even if a new one is loaded while searching
+	shared_ptr<const MapSnapshot> map = m_streetMap->getSnapshot();
+	if (map == nullptr)
+		return BAD_COORD;
+	const StreetGraph& graph = *map->graph;
+	int startNode = graph.findNode(start);
+	int endNode = graph.findNode(end);
+	if (startNode == -1 || endNode == -1)	//if start or end is not in map, it is a bad coord
+		return BAD_COORD;
+
+	//all of the search's working memory is released together when the arena goes away
+	pmr::monotonic_buffer_resource arena;
+	RouteScratch scratch(graph, &arena);
+	EdgeRoute edges(&arena);
+	DeliveryResult result = searchRoute(*map, startNode, endNode, edges, totalDistanceTravelled, scratch, maxSuboptimality, &stats, cancel);
+	if (result == DELIVERY_SUCCESS)
+		appendSegments(graph, edges, route);
+	return result;
+}
+
+//the same search over a tiled map, reading each tile the first time the search reaches
+//it; state is kept only for the nodes reached, since the map may be far bigger than the
+//part of it a search touches
+DeliveryResult searchTiledRoute(const TiledMap& map, const GeoCoord& start, const GeoCoord& end, double weight,
+	list<StreetSegment>& route, double& totalDistanceTravelled, RouteSearchStats& stats, const CancellationToken* cancel)
+{
+	int startNode = map.findNode(start);
+	int endNode = map.findNode(end);
+	if (startNode == -1 || endNode == -1)	//if start or end is not in map, it is a bad coord
 		return BAD_COORD;
-	
-	//f-value, location
-	priority_queue < pair<double, GeoCoord>, vector<pair<double, GeoCoord>>, greater<pair<double, GeoCoord>> > openLocations;
-	//current location : previous location 
-	ExpandableHashMap<GeoCoord, GeoCoord> routeMap;
-	//location : cost from start
-	ExpandableHashMap<GeoCoord, double> totalCosts;
-
-	// g is the total distance to get to the location
-	double g = 0;
-	// f = g + distance to end
-	double f = 0;
-	GeoCoord currentLoc;
-	pair<double, GeoCoord> priorityPair;
-	priorityPair.first = f;
-	priorityPair.second = start;
-	totalCosts.associate(start, g);
-	openLocations.push(priorityPair);
-
-	vector<StreetSegment> nextSegments;
-	GeoCoord nextLoc;
-	double* oldGVal;
+	if (startNode == endNode)
+		return DELIVERY_SUCCESS;
+
+	//every tile this search has used, held so the cache can't drop one out from under it
+	unordered_map<int, shared_ptr<const MapTile>> tiles;
+	auto tileFor = [&map, &tiles](int node) -> const MapTile*
+	{
+		int t = map.tileOf(node);
+		auto found = tiles.find(t);
+		if (found == tiles.end())
+			found = tiles.insert(make_pair(t, map.tile(t))).first;
+		return found->second.get();
+	};
+	const MapTile* startTile = tileFor(startNode);
+	const MapTile* endTile = tileFor(endNode);
+	if (startTile == nullptr || endTile == nullptr)
+		return NO_ROUTE;
+	if (startTile->components[startTile->local(startNode)] != endTile->components[endTile->local(endNode)])
+		return NO_ROUTE;
 
+	struct Reached
+	{
+		double cost;
+		int from;
+		int edge;	//within from's tile
+		bool closed;
+	};
+	unordered_map<int, Reached> reached;
+	const GeoCoord endCoord = end;
+	weight = max(weight, 1.0);
+	bool reopen = weight > 1;
+	vector<pair<double, int>> openLocations;
+	greater<pair<double, int>> later;
+	reached[startNode] = Reached{ 0, -1, -1, false };
+	stats.nodesReached = 1;
+	openLocations.push_back(make_pair(0.0, startNode));
 	while (!openLocations.empty())
 	{
-		currentLoc = openLocations.top().second;
-		openLocations.pop();
-		if (currentLoc == end)	//if end found, retrieve route to get there
+		pop_heap(openLocations.begin(), openLocations.end(), later);
+		int current = openLocations.back().second;
+		openLocations.pop_back();
+		Reached& currentState = reached[current];
+		if (currentState.closed)	//a shorter way here was already processed
+			continue;
+		currentState.closed = true;
+		stats.nodesExpanded++;
+		if (cancel != nullptr && stats.nodesExpanded % CANCEL_CHECK_INTERVAL == 0 && cancel->cancelled())
+			return CANCELLED;
+		const MapTile* tile = tileFor(current);
+		if (tile == nullptr)	//couldn't read this part of the map
+			return NO_ROUTE;
+		if (current == endNode)	//walk the edges back to the start
 		{
-			GeoCoord previous;
-			GeoCoord currentCoord = currentLoc;
-			while (previous != start)
+			for (int node = endNode; node != startNode; )
+			{
+				const Reached& step = reached[node];
+				const MapTile* fromTile = tileFor(step.from);
+				const MapTile* toTile = tileFor(node);
+				route.push_front(StreetSegment(fromTile->coords[fromTile->local(step.from)], toTile->coords[toTile->local(node)],
+					fromTile->names[fromTile->edgeName[step.edge]]));
+				totalDistanceTravelled += fromTile->edgeLength[step.edge];
+				node = step.from;
+			}
+			if (reopen)	//the same lower bound as searchRoute
 			{
-				previous = *(routeMap.find(currentCoord));
-				StreetSegment s;
-				s.start = previous;
-				s.end = currentCoord;
-				vector<StreetSegment> nameFinder;
-				m_streetMap->getSegmentsThatStartWith(previous, nameFinder);
-				for (int i = 0; i < nameFinder.size(); i++)
+				double lowerBound = HUGE_VAL;
+				for (int i = 0; i < openLocations.size(); i++)
 				{
-					if (nameFinder[i].end == currentCoord)
-					{
-						s.name = nameFinder[i].name;
-						break;
-					}
+					int node = openLocations[i].second;
+					const Reached& state = reached[node];
+					const MapTile* nodeTile = tileFor(node);
+					if (!state.closed)
+						lowerBound = min(lowerBound, state.cost + distanceEarthMiles(nodeTile->coords[nodeTile->local(node)], endCoord));
 				}
-				route.push_front(s);
-				totalDistanceTravelled += distanceEarthMiles(s.start, s.end);
-				currentCoord = previous;
+				if (currentState.cost > lowerBound)
+					stats.suboptimalityBound = min(weight, currentState.cost / lowerBound);
 			}
 			return DELIVERY_SUCCESS;
 		}
-		
-		//get all connected street segments
-		m_streetMap->getSegmentsThatStartWith(currentLoc, nextSegments);
-		for (int i = 0; i < nextSegments.size(); i++)
+
+		double currentCost = currentState.cost;
+		int local = tile->local(current);
+		for (int e = tile->firstEdge[local]; e < tile->firstEdge[local + 1]; e++)
 		{
-			nextLoc = nextSegments[i].end;
+			int next = tile->edgeTarget[e];
+			double g = currentCost + tile->edgeLength[e];
+			auto found = reached.find(next);
+			if (found != reached.end() && (found->second.closed && !reopen))
+				continue;
+			if (found == reached.end() || g < found->second.cost)
+			{
+				const MapTile* nextTile = tileFor(next);	//crossing a boundary reads the next tile
+				if (nextTile == nullptr)
+					return NO_ROUTE;
+				if (found == reached.end())
+					stats.nodesReached++;
+				reached[next] = Reached{ g, current, e, false };
+				double f = g + weight * distanceEarthMiles(nextTile->coords[nextTile->local(next)], endCoord);
+				openLocations.push_back(make_pair(f, next));
+				push_heap(openLocations.begin(), openLocations.end(), later);
+			}
+		}
+	}
+	return NO_ROUTE;
+}
 
-			g = *(totalCosts.find(currentLoc)) + distanceEarthMiles(currentLoc, nextLoc);
+//the same search over a compressed graph, decoding each node's edges as it is expanded.
+//Costs are the rounded up lengths the graph stores; the distance reported is worked out
+//from the exact coordinates, as StreetGraph's edge lengths are
+DeliveryResult searchCompressedRoute(const CompressedGraph& graph, const GeoCoord& start, const GeoCoord& end, double weight,
+	list<StreetSegment>& route, double& totalDistanceTravelled, RouteSearchStats& stats, const CancellationToken* cancel)
+{
+	int startNode = graph.findNode(start);
+	int endNode = graph.findNode(end);
+	if (startNode == -1 || endNode == -1)
+		return BAD_COORD;
+	if (startNode == endNode)
+		return DELIVERY_SUCCESS;
+	if (graph.component(startNode) != graph.component(endNode))
+		return NO_ROUTE;
 
-			oldGVal = totalCosts.find(nextLoc);
-			//if this location has not yet been visited or is better than the previous route, process it
-			if (oldGVal == nullptr || (g < *oldGVal))
+	pmr::monotonic_buffer_resource arena;
+	RouteScratch scratch(graph.nodeCount(), &arena);
+	//a coord whose numbers are overwritten for each estimate, so no text is built in the loop
+	GeoCoord here;
+	GeoCoord endCoord;
+	endCoord.latitude = graph.latitude(endNode);
+	endCoord.longitude = graph.longitude(endNode);
+	auto estimate = [&](int node)
+	{
+		here.latitude = graph.latitude(node);
+		here.longitude = graph.longitude(node);
+		return distanceEarthMiles(here, endCoord);
+	};
+	weight = max(weight, 1.0);
+	bool reopen = weight > 1;
+	pmr::vector<pair<double, int>>& openLocations = scratch.openLocations;
+	greater<pair<double, int>> later;
+	scratch.reset();
+	scratch.reach(startNode, 0, -1);
+	stats.nodesReached = 1;
+	openLocations.push_back(make_pair(0.0, startNode));
+	//node : the node its edge in leaves from, which the compressed edges don't record
+	pmr::vector<int> sources(graph.nodeCount(), -1, &arena);
+	while (!openLocations.empty())
+	{
+		pop_heap(openLocations.begin(), openLocations.end(), later);
+		int current = openLocations.back().second;
+		openLocations.pop_back();
+		if (scratch.closed(current))
+			continue;
+		scratch.close(current);
+		stats.nodesExpanded++;
+		if (cancel != nullptr && stats.nodesExpanded % CANCEL_CHECK_INTERVAL == 0 && cancel->cancelled())
+			return CANCELLED;
+		if (current == endNode)	//walk the edges back to the start
+		{
+			for (int node = endNode; node != startNode; node = sources[node])
 			{
-				routeMap.associate(nextLoc, currentLoc);
-				//record the g value to get to Loc
-				totalCosts.associate(nextLoc, g);
-				f = g + distanceEarthMiles(nextLoc, end);
-				priorityPair.first = f;
-				priorityPair.second = nextLoc;
-				openLocations.push(priorityPair);
+				int from = sources[node];
+				int wanted = scratch.edgeTo(node);
+				int nameId = -1;
+				graph.forEachEdge(from, [&](int edge, int, double, int name)
+				{
+					if (edge == wanted)
+						nameId = name;
+				});
+				GeoCoord fromCoord = graph.coord(from);
+				GeoCoord toCoord = graph.coord(node);
+				totalDistanceTravelled += distanceEarthMiles(fromCoord, toCoord);
+				route.push_front(StreetSegment(fromCoord, toCoord, graph.name(nameId)));
 			}
+			if (reopen)	//the same lower bound as searchRoute
+			{
+				double lowerBound = HUGE_VAL;
+				for (int i = 0; i < openLocations.size(); i++)
+				{
+					int node = openLocations[i].second;
+					if (!scratch.closed(node))
+						lowerBound = min(lowerBound, scratch.cost(node) + estimate(node));
+				}
+				if (scratch.cost(endNode) > lowerBound)
+					stats.suboptimalityBound = min(weight, scratch.cost(endNode) / lowerBound);
+			}
+			return DELIVERY_SUCCESS;
 		}
+
+		double currentCost = scratch.cost(current);
+		graph.forEachEdge(current, [&](int edge, int next, double length, int)
+		{
+			if (scratch.closed(next) && !reopen)
+				return;
+			double g = currentCost + length;
+			if (!scratch.reached(next) || g < scratch.cost(next))
+			{
+				if (!scratch.reached(next))
+					stats.nodesReached++;
+				scratch.reach(next, g, edge);
+				sources[next] = current;
+				openLocations.push_back(make_pair(g + weight * estimate(next), next));
+				push_heap(openLocations.begin(), openLocations.end(), later);
+			}
+		});
 	}
-    return NO_ROUTE;
+	return NO_ROUTE;
 }
 
 //******************** PointToPointRouter functions ***************************
@@ -131,6 +619,16 @@ PointToPointRouter::PointToPointRouter(const StreetMap* sm)
     m_impl = new PointToPointRouterImpl(sm);
 }
 
+PointToPointRouter::PointToPointRouter(const TiledMap* tm)
+{
+    m_impl = new PointToPointRouterImpl(tm);
+}
+
+PointToPointRouter::PointToPointRouter(const CompressedGraph* cg)
+{
+    m_impl = new PointToPointRouterImpl(cg);
+}
+
 PointToPointRouter::~PointToPointRouter()
 {
     delete m_impl;
@@ -145,3 +643,24 @@ DeliveryResult PointToPointRouter::generatePointToPointRoute(
     return m_impl->generatePointToPointRoute(start, end, route, totalDistanceTravelled);
 }
 
+DeliveryResult PointToPointRouter::generatePointToPointRoute(
+        const GeoCoord& start,
+        const GeoCoord& end,
+        double maxSuboptimality,
+        list<StreetSegment>& route,
+        double& totalDistanceTravelled,
+        RouteSearchStats& stats) const
+{
+    return m_impl->generatePointToPointRoute(start, end, maxSuboptimality, route, totalDistanceTravelled, stats, nullptr);
+}
+
+DeliveryResult PointToPointRouter::generatePointToPointRoute(
+        const GeoCoord& start,
+        const GeoCoord& end,
+        list<StreetSegment>& route,
+        double& totalDistanceTravelled,
+        const CancellationToken& cancel) const
+{
+    RouteSearchStats stats;
+    return m_impl->generatePointToPointRoute(start, end, 1, route, totalDistanceTravelled, stats, &cancel);
+}
@@ -0,0 +1,179 @@
+#include "provided.h"
+#include "QueryLog.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <vector>
+using namespace std;
+
+//identifies a query log file, and which version of the layout it uses
+const uint32_t QUERY_LOG_MAGIC = 0x31474c51;	//"QLG1"
+//records are gathered in memory and written out once there is this much
+const size_t LOG_BLOCK_BYTES = 1 << 20;
+
+atomic<QueryLog*> QueryLog::s_active(nullptr);
+
+QueryLog::QueryLog()
+{
+}
+
+QueryLog::~QueryLog()
+{
+	close();
+}
+
+bool QueryLog::open(string logFile)
+{
+	close();
+	lock_guard<mutex> lock(m_mutex);
+	m_file.open(logFile, ios::binary | ios::trunc);
+	if (!m_file)
+		return false;
+	m_buffer.clear();
+	m_buffer.put<uint32_t>(QUERY_LOG_MAGIC);
+	m_opened = chrono::steady_clock::now();
+	return true;
+}
+
+void QueryLog::close()
+{
+	lock_guard<mutex> lock(m_mutex);
+	if (!m_file.is_open())
+		return;
+	m_file.write(m_buffer.bytes().data(), m_buffer.bytes().size());
+	m_buffer.clear();
+	m_file.close();
+}
+
+void QueryLog::setActive(QueryLog* log)
+{
+	s_active.store(log, memory_order_release);
+}
+
+//coords are short texts; a text that is somehow longer is stored long so nothing is cut off
+void putCoord(ByteWriter& record, const GeoCoord& gc)
+{
+	record.putText(gc.latitudeText, true);
+	record.putText(gc.longitudeText, true);
+}
+
+bool getCoord(ByteReader& reader, GeoCoord& gc)
+{
+	string lat;
+	string lon;
+	if (!reader.getText(lat, true) || !reader.getText(lon, true))
+		return false;
+	gc.latitudeText = lat;
+	gc.longitudeText = lon;
+	gc.latitude = atof(lat.c_str());
+	gc.longitude = atof(lon.c_str());
+	return true;
+}
+
+void QueryLog::putHeader(ByteWriter& record, LoggedCall call, chrono::steady_clock::time_point started,
+	DeliveryResult result, double distance) const
+{
+	chrono::steady_clock::time_point now = chrono::steady_clock::now();
+	record.put<uint8_t>(call);
+	record.put<uint8_t>(result);
+	record.put<double>(chrono::duration<double, micro>(started - m_opened).count());
+	record.put<double>(chrono::duration<double, micro>(now - started).count());
+	record.put<double>(distance);
+}
+
+void QueryLog::recordRoute(chrono::steady_clock::time_point started, const GeoCoord& start, const GeoCoord& end,
+	double maxSuboptimality, DeliveryResult result, double distance)
+{
+	ByteWriter record;
+	putHeader(record, LOGGED_ROUTE, started, result, distance);
+	record.put<double>(maxSuboptimality);
+	putCoord(record, start);
+	putCoord(record, end);
+	append(record);
+}
+
+void QueryLog::recordPlan(chrono::steady_clock::time_point started, const GeoCoord& depot,
+	const vector<DeliveryRequest>& deliveries, DeliveryResult result, double distance, int commandCount)
+{
+	ByteWriter record;
+	putHeader(record, LOGGED_PLAN, started, result, distance);
+	record.put<int32_t>(commandCount);
+	putCoord(record, depot);
+	record.put<uint32_t>(deliveries.size());
+	for (int i = 0; i < deliveries.size(); i++)
+	{
+		putCoord(record, deliveries[i].location);
+		record.putText(deliveries[i].item, true);
+	}
+	append(record);
+}
+
+void QueryLog::append(const ByteWriter& record)
+{
+	lock_guard<mutex> lock(m_mutex);
+	if (!m_file.is_open())	//closed while the call was running
+		return;
+	m_buffer.putText(record.bytes(), true);	//length first, so a record cut off by a crash is recognised
+	if (m_buffer.bytes().size() >= LOG_BLOCK_BYTES)
+	{
+		m_file.write(m_buffer.bytes().data(), m_buffer.bytes().size());
+		m_buffer.clear();
+	}
+}
+
+bool readRecord(const string& bytes, LoggedQuery& query)
+{
+	ByteReader reader(bytes);
+	uint8_t call = 0;
+	uint8_t result = 0;
+	if (!reader.get(call) || !reader.get(result) || !reader.get(query.startedAt) || !reader.get(query.latency)
+		|| !reader.get(query.distance))
+		return false;
+	query.call = (LoggedCall)call;
+	query.result = (DeliveryResult)result;
+	query.commandCount = 0;
+	query.maxSuboptimality = 1;
+	query.deliveries.clear();
+	if (call == LOGGED_ROUTE)
+		return reader.get(query.maxSuboptimality) && getCoord(reader, query.start) && getCoord(reader, query.end);
+	int32_t commandCount = 0;
+	uint32_t numDeliveries = 0;
+	if (call != LOGGED_PLAN || !reader.get(commandCount) || !getCoord(reader, query.start) || !reader.get(numDeliveries))
+		return false;
+	query.commandCount = commandCount;
+	for (uint32_t i = 0; i < numDeliveries; i++)
+	{
+		GeoCoord location;
+		string item;
+		if (!getCoord(reader, location) || !reader.getText(item, true))
+			return false;
+		query.deliveries.push_back(DeliveryRequest(item, location));
+	}
+	return true;
+}
+
+bool QueryLog::read(string logFile, vector<LoggedQuery>& queries)
+{
+	queries.clear();
+	ifstream inf(logFile, ios::binary);
+	if (!inf)
+		return false;
+	string bytes((istreambuf_iterator<char>(inf)), istreambuf_iterator<char>());
+	ByteReader reader(bytes);
+	uint32_t magic = 0;
+	if (!reader.get(magic) || magic != QUERY_LOG_MAGIC)
+		return false;
+	string record;
+	while (reader.getText(record, true))
+	{
+		LoggedQuery query;
+		if (!readRecord(record, query))
+			break;
+		queries.push_back(std::move(query));
+	}
+	return true;
+}
@@ -0,0 +1,80 @@
+// QueryLog.h
+
+// A binary record of the routes and plans asked for, so a production workload can be
+// replayed offline (see tools/ReplayLog.cpp).  While a log is active, every
+// PointToPointRouter and DeliveryPlanner call appends its inputs, result, distance and
+// latency to it.  Records are encoded on the calling thread and gathered in memory to be
+// written out a megabyte at a time, so a call usually pays for one short lock and no
+// I/O; with no log active the only cost is reading one pointer.
+#ifndef QUERYLOG_INCLUDED
+#define QUERYLOG_INCLUDED
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "provided.h"
+#include "ByteBuffer.h"
+
+enum LoggedCall
+{
+	LOGGED_ROUTE, LOGGED_PLAN
+};
+
+struct LoggedQuery
+{
+	LoggedCall call;
+	double startedAt;	//microseconds after the log was opened
+	double latency;	//microseconds
+	DeliveryResult result;
+	double distance;
+	int commandCount;	//plans only; -1 if the commands were streamed to a sink
+	double maxSuboptimality;	//routes only
+	GeoCoord start;	//the depot, for plans
+	GeoCoord end;	//routes only
+	std::vector<DeliveryRequest> deliveries;	//plans only
+};
+
+class QueryLog
+{
+public:
+	QueryLog();
+	~QueryLog();
+	  // start a new log in logFile, replacing anything there
+	bool open(std::string logFile);
+	  // write out whatever is still buffered and close the file
+	void close();
+
+	void recordRoute(std::chrono::steady_clock::time_point started, const GeoCoord& start, const GeoCoord& end,
+		double maxSuboptimality, DeliveryResult result, double distance);
+	void recordPlan(std::chrono::steady_clock::time_point started, const GeoCoord& depot,
+		const std::vector<DeliveryRequest>& deliveries, DeliveryResult result, double distance, int commandCount);
+
+	  // every record in a log, in the order they were written; false if the file can't be
+	  // read or isn't a query log (a log cut off mid record keeps the records before it)
+	static bool read(std::string logFile, std::vector<LoggedQuery>& queries);
+
+	  // the log that calls are recorded in, or nullptr (the default) to record nothing.
+	  // Clear it and let calls in flight return before destroying the log.
+	static void setActive(QueryLog* log);
+	static QueryLog* active() { return s_active.load(std::memory_order_acquire); }
+
+	QueryLog(const QueryLog&) = delete;
+	QueryLog& operator=(const QueryLog&) = delete;
+
+private:
+	static std::atomic<QueryLog*> s_active;
+
+	std::mutex m_mutex;
+	std::ofstream m_file;
+	ByteWriter m_buffer;
+	std::chrono::steady_clock::time_point m_opened;
+
+	void append(const ByteWriter& record);
+	void putHeader(ByteWriter& record, LoggedCall call, std::chrono::steady_clock::time_point started,
+		DeliveryResult result, double distance) const;
+};
+
+#endif // QUERYLOG_INCLUDED
@@ -0,0 +1,87 @@
+// RouteSearch.h
+
+// Node level route search over a StreetGraph.  PointToPointRouter wraps this for
+// coords; code that already works with node numbers can call it directly and skip
+// building StreetSegments for every step.
+#ifndef ROUTESEARCH_INCLUDED
+#define ROUTESEARCH_INCLUDED
+
+#include <list>
+#include <vector>
+#include <memory_resource>
+#include "provided.h"
+#include "StreetGraph.h"
+#include "MapSnapshot.h"
+
+  // A route as the numbers of the graph edges it drives along, in order.  It costs four
+  // bytes a step where a list of StreetSegments costs a list node and several strings.
+typedef std::pmr::vector<int> EdgeRoute;
+
+  // Working state of a search, sized to the graph once and reused by every search it is
+  // handed, so routing many legs costs no allocations after the first.  All of its memory
+  // comes from the resource it was built with, typically a per-request arena.
+class RouteScratch
+{
+public:
+	RouteScratch(const StreetGraph& graph, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+	RouteScratch(int nodeCount, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+	  // start a new search; every node becomes unreached without touching the arrays
+	void reset();
+	bool reached(int node) const { return m_stamps[node] >= m_stamp; }
+	bool closed(int node) const { return m_stamps[node] == m_stamp + 1; }
+	void reach(int node, double cost, int edge);
+	void close(int node) { m_stamps[node] = m_stamp + 1; }
+	double cost(int node) const { return m_costs[node]; }
+	int edgeTo(int node) const { return m_edges[node]; }
+
+	  // f-value, node; kept as a heap with push_heap/pop_heap
+	std::pmr::vector<std::pair<double, int>> openLocations;
+
+	RouteScratch(const RouteScratch&) = delete;
+	RouteScratch& operator=(const RouteScratch&) = delete;
+
+private:
+	//node : cost from start
+	std::pmr::vector<double> m_costs;
+	//node : edge used to reach it
+	std::pmr::vector<int> m_edges;
+	//node : search it was last reached in, plus one once it is closed
+	std::pmr::vector<unsigned int> m_stamps;
+	unsigned int m_stamp;
+};
+
+  // A* from start to end using the snapshot's edge weights as costs; on success edges
+  // holds the edge numbers of the route in order and totalDistanceTravelled its length.
+  // A weight above 1 inflates the estimate (weighted A*), giving a route that costs at
+  // most weight times the cheapest; if stats isn't null it gets the search effort and
+  // the bound actually proven.  If cancel isn't null the search gives up with CANCELLED
+  // soon after it is cancelled.
+DeliveryResult searchRoute(const MapSnapshot& map, int start, int end,
+    EdgeRoute& edges, double& totalDistanceTravelled, RouteScratch& scratch,
+    double weight = 1, RouteSearchStats* stats = nullptr, const CancellationToken* cancel = nullptr);
+
+  // Dijkstra from start until every node in ends is reached; routes[i], distances[i] and
+  // results[i] are the route to ends[i], its length, and DELIVERY_SUCCESS or NO_ROUTE.
+  // One search serves every destination, so it is much cheaper than a search per leg
+  // when many legs leave the same place.
+void searchRoutesFrom(const MapSnapshot& map, int start, const std::vector<int>& ends,
+    std::vector<EdgeRoute>& routes, std::vector<double>& distances,
+    std::vector<DeliveryResult>& results, RouteScratch& scratch);
+
+  // Dijkstra from start out to maxDistance miles of road; nodes gets every node reached
+  // within it, nearest first, and distances how far each is.  Closed roads aren't driven,
+  // but other edge weights are ignored since the budget is in miles.  Afterwards scratch
+  // still holds the search, so callers can look at the edges leaving the area.
+void searchWithin(const MapSnapshot& map, int start, double maxDistance,
+    std::vector<int>& nodes, std::vector<double>& distances, RouteScratch& scratch);
+
+  // append the street segments of a route found by searchRoute
+template<typename SegmentList>
+void appendSegments(const StreetGraph& graph, const EdgeRoute& edges, SegmentList& route)
+{
+	for (int i = 0; i < edges.size(); i++)
+		route.push_back(graph.segment(edges[i]));
+}
+
+#endif // ROUTESEARCH_INCLUDED
@@ -0,0 +1,236 @@
+#include "provided.h"
+#include "ServiceArea.h"
+#include "RouteSearch.h"
+#include "MapSnapshot.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+using namespace std;
+
+class ServiceAreaImpl
+{
+public:
+    ServiceAreaImpl(const StreetMap* sm, int numWorkers);
+    ~ServiceAreaImpl();
+    DeliveryResult findServiceArea(const GeoCoord& depot, double maxMiles, bool withBoundary,
+        ServiceAreaResult& result) const;
+    void findServiceAreas(const vector<GeoCoord>& depots, double maxMiles, bool withBoundary,
+        vector<ServiceAreaResult>& results) const;
+    DeliveryResult testAddresses(const GeoCoord& depot, double maxMiles, const vector<GeoCoord>& addresses,
+        vector<bool>& within) const;
+private:
+	const StreetMap* m_streetMap;
+	int m_numWorkers;
+};
+
+//a candidate corner of the boundary: a node, or a point part way along a road (node -1)
+struct BoundaryPoint
+{
+	double longitude;
+	double latitude;
+	int node;
+};
+
+bool operator<(const BoundaryPoint& lhs, const BoundaryPoint& rhs)
+{
+	if (lhs.longitude != rhs.longitude)
+		return lhs.longitude < rhs.longitude;
+	return lhs.latitude < rhs.latitude;
+}
+
+//positive if o, a, b turn counterclockwise
+double turn(const BoundaryPoint& o, const BoundaryPoint& a, const BoundaryPoint& b)
+{
+	return (a.longitude - o.longitude) * (b.latitude - o.latitude) - (a.latitude - o.latitude) * (b.longitude - o.longitude);
+}
+
+GeoCoord boundaryCoord(const StreetGraph& graph, const BoundaryPoint& point)
+{
+	if (point.node != -1)
+		return graph.coord(point.node);
+	char latitude[32];
+	char longitude[32];
+	snprintf(latitude, sizeof(latitude), "%.7f", point.latitude);
+	snprintf(longitude, sizeof(longitude), "%.7f", point.longitude);
+	return GeoCoord(latitude, longitude);
+}
+
+//the convex hull of the nodes the search closed and of the points where the budget runs
+//out along the roads leaving them (Andrew's monotone chain)
+void findBoundary(const MapSnapshot& map, const vector<int>& nodes, double maxMiles, const RouteScratch& scratch,
+	vector<GeoCoord>& boundary)
+{
+	const StreetGraph& graph = *map.graph;
+	const EdgeWeights& weights = *map.weights;
+	vector<BoundaryPoint> points;
+	for (int i = 0; i < nodes.size(); i++)
+	{
+		int node = nodes[i];
+		const GeoCoord& from = graph.coord(node);
+		points.push_back(BoundaryPoint{ from.longitude, from.latitude, node });
+		for (int e = graph.firstEdge(node); e < graph.firstEdge(node + 1); e++)
+		{
+			int next = graph.edgeTarget(e);
+			if (scratch.closed(next) || isinf(weights.multiplier(e)) || graph.edgeLength(e) <= 0)
+				continue;
+			double along = (maxMiles - scratch.cost(node)) / graph.edgeLength(e);
+			const GeoCoord& to = graph.coord(next);
+			points.push_back(BoundaryPoint{ from.longitude + along * (to.longitude - from.longitude),
+				from.latitude + along * (to.latitude - from.latitude), -1 });
+		}
+	}
+	sort(points.begin(), points.end());
+	points.erase(unique(points.begin(), points.end(), [](const BoundaryPoint& lhs, const BoundaryPoint& rhs)
+	{
+		return lhs.longitude == rhs.longitude && lhs.latitude == rhs.latitude;
+	}), points.end());
+	boundary.clear();
+	if (points.size() < 3)
+		return;
+
+	vector<BoundaryPoint> hull(2 * points.size());
+	int k = 0;
+	for (int i = 0; i < points.size(); i++)	//lower hull
+	{
+		while (k >= 2 && turn(hull[k - 2], hull[k - 1], points[i]) <= 0)
+			k--;
+		hull[k++] = points[i];
+	}
+	for (int i = points.size() - 2, lower = k + 1; i >= 0; i--)	//upper hull
+	{
+		while (k >= lower && turn(hull[k - 2], hull[k - 1], points[i]) <= 0)
+			k--;
+		hull[k++] = points[i];
+	}
+	if (k - 1 < 3)	//every point on one line, so there is no area to outline
+		return;
+	for (int i = 0; i + 1 < k; i++)	//the last point is the first again
+		boundary.push_back(boundaryCoord(graph, hull[i]));
+}
+
+DeliveryResult findArea(const MapSnapshot& map, const GeoCoord& depot, double maxMiles, bool withBoundary,
+	ServiceAreaResult& result)
+{
+	const StreetGraph& graph = *map.graph;
+	result.status = BAD_COORD;
+	result.reachable.clear();
+	result.distances.clear();
+	result.boundary.clear();
+	int start = graph.findNode(depot);
+	if (start == -1)
+		return BAD_COORD;
+	maxMiles = max(maxMiles, 0.0);
+
+	pmr::monotonic_buffer_resource arena;
+	RouteScratch scratch(graph, &arena);
+	vector<int> nodes;
+	searchWithin(map, start, maxMiles, nodes, result.distances, scratch);
+	result.reachable.reserve(nodes.size());
+	for (int i = 0; i < nodes.size(); i++)
+		result.reachable.push_back(graph.coord(nodes[i]));
+	if (withBoundary)
+		findBoundary(map, nodes, maxMiles, scratch, result.boundary);
+	result.status = DELIVERY_SUCCESS;
+	return DELIVERY_SUCCESS;
+}
+
+ServiceAreaImpl::ServiceAreaImpl(const StreetMap* sm, int numWorkers)
+{
+	m_streetMap = sm;
+	m_numWorkers = numWorkers;
+}
+
+ServiceAreaImpl::~ServiceAreaImpl()
+{
+}
+
+DeliveryResult ServiceAreaImpl::findServiceArea(const GeoCoord& depot, double maxMiles, bool withBoundary,
+	ServiceAreaResult& result) const
+{
+	shared_ptr<const MapSnapshot> map = m_streetMap->getSnapshot();
+	if (map == nullptr)
+	{
+		result = ServiceAreaResult();
+		result.status = BAD_COORD;
+		return BAD_COORD;
+	}
+	return findArea(*map, depot, maxMiles, withBoundary, result);
+}
+
+void ServiceAreaImpl::findServiceAreas(const vector<GeoCoord>& depots, double maxMiles, bool withBoundary,
+	vector<ServiceAreaResult>& results) const
+{
+	results.assign(depots.size(), ServiceAreaResult());
+	for (int d = 0; d < depots.size(); d++)
+		results[d].status = BAD_COORD;
+	//every depot is searched on the same version of the map
+	shared_ptr<const MapSnapshot> map = m_streetMap->getSnapshot();
+	if (map == nullptr)
+		return;
+	parallelFor(depots.size(), [&](int d)
+	{
+		findArea(*map, depots[d], maxMiles, withBoundary, results[d]);
+	}, m_numWorkers);
+}
+
+DeliveryResult ServiceAreaImpl::testAddresses(const GeoCoord& depot, double maxMiles, const vector<GeoCoord>& addresses,
+	vector<bool>& within) const
+{
+	within.assign(addresses.size(), false);
+	shared_ptr<const MapSnapshot> map = m_streetMap->getSnapshot();
+	if (map == nullptr)
+		return BAD_COORD;
+	const StreetGraph& graph = *map->graph;
+	int start = graph.findNode(depot);
+	if (start == -1)
+		return BAD_COORD;
+
+	//one search settles every address; a node the search closed is within the budget
+	pmr::monotonic_buffer_resource arena;
+	RouteScratch scratch(graph, &arena);
+	vector<int> nodes;
+	vector<double> distances;
+	searchWithin(*map, start, max(maxMiles, 0.0), nodes, distances, scratch);
+	for (int i = 0; i < addresses.size(); i++)
+	{
+		int node = graph.findNode(addresses[i]);
+		within[i] = node != -1 && scratch.closed(node);
+	}
+	return DELIVERY_SUCCESS;
+}
+
+//******************** ServiceArea functions **********************************
+
+// These functions simply delegate to ServiceAreaImpl's functions.
+
+ServiceArea::ServiceArea(const StreetMap* sm, int numWorkers)
+{
+    m_impl = new ServiceAreaImpl(sm, numWorkers);
+}
+
+ServiceArea::~ServiceArea()
+{
+    delete m_impl;
+}
+
+DeliveryResult ServiceArea::findServiceArea(const GeoCoord& depot, double maxMiles, bool withBoundary,
+    ServiceAreaResult& result) const
+{
+    return m_impl->findServiceArea(depot, maxMiles, withBoundary, result);
+}
+
+void ServiceArea::findServiceAreas(const vector<GeoCoord>& depots, double maxMiles, bool withBoundary,
+    vector<ServiceAreaResult>& results) const
+{
+    m_impl->findServiceAreas(depots, maxMiles, withBoundary, results);
+}
+
+DeliveryResult ServiceArea::testAddresses(const GeoCoord& depot, double maxMiles, const vector<GeoCoord>& addresses,
+    vector<bool>& within) const
+{
+    return m_impl->testAddresses(depot, maxMiles, addresses, within);
+}
@@ -0,0 +1,50 @@
+// ServiceArea.h
+
+// Answers "what can a depot reach within so many road miles?" with one bounded search
+// from the depot instead of a route to every candidate address.  A search stops as soon
+// as the nearest unexplored node is past the budget, so its cost grows with the size of
+// the area rather than the map.  Many depots are searched at once on a pool of threads.
+#ifndef SERVICEAREA_INCLUDED
+#define SERVICEAREA_INCLUDED
+
+#include <vector>
+#include "provided.h"
+
+struct ServiceAreaResult
+{
+    DeliveryResult status;
+      // every intersection within the budget, nearest first, and its distance in miles
+    std::vector<GeoCoord> reachable;
+    std::vector<double> distances;
+      // if asked for, the convex hull of the area counterclockwise, including the points
+      // part way along roads where the budget runs out; empty when those points don't
+      // enclose an area, i.e. there are fewer than three or they all lie on one line
+    std::vector<GeoCoord> boundary;
+};
+
+class ServiceAreaImpl;
+
+class ServiceArea
+{
+public:
+      // numWorkers threads at most; 0 uses one per core
+    ServiceArea(const StreetMap* sm, int numWorkers = 0);
+    ~ServiceArea();
+      // BAD_COORD if the depot isn't on the map
+    DeliveryResult findServiceArea(const GeoCoord& depot, double maxMiles, bool withBoundary,
+        ServiceAreaResult& result) const;
+      // results gets one entry per depot, in the same order as depots
+    void findServiceAreas(const std::vector<GeoCoord>& depots, double maxMiles, bool withBoundary,
+        std::vector<ServiceAreaResult>& results) const;
+      // within[i] is whether addresses[i] is at most maxMiles of road from the depot; an
+      // address that isn't on the map is never within.  BAD_COORD if the depot isn't on
+      // the map.
+    DeliveryResult testAddresses(const GeoCoord& depot, double maxMiles, const std::vector<GeoCoord>& addresses,
+        std::vector<bool>& within) const;
+    ServiceArea(const ServiceArea&) = delete;
+    ServiceArea& operator=(const ServiceArea&) = delete;
+private:
+    ServiceAreaImpl* m_impl;
+};
+
+#endif // SERVICEAREA_INCLUDED
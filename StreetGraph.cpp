@@ -0,0 +1,320 @@
+#include "provided.h"
+#include "StreetGraph.h"
+#include "HilbertCurve.h"
+#include <string>
+#include <vector>
+#include <list>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+using namespace std;
+
+StreetGraph::StreetGraph()
+{
+}
+
+bool StreetGraph::load(string mapFile, NodeOrder order)
+{
+	ifstream inf(mapFile);	//read in mapfile
+	if (!inf)			//return false if could not be read in
+		return false;
+
+	//every segment becomes two edges, kept in file order until they are grouped by start node
+	vector<int> sources;
+	vector<int> targets;
+	vector<int> names;
+	string line;
+	while (getline(inf, line))
+	{
+		if (line == "")		//if there is an empty line at the end of the file, break
+			break;
+		int nameId = m_names.size();
+		m_names.push_back(line);
+
+		if (!getline(inf, line))
+			return false;
+		istringstream iss(line);	//number following should be how many line segments follow the name
+		int numCoords = 0;
+		iss >> numCoords;
+
+		for (int i = 0; i < numCoords; i++)
+		{
+			if (!getline(inf, line))
+				return false;
+			istringstream iss2(line);
+			string latitude1;
+			string longitude1;
+			string latitude2;
+			string longitude2;
+			iss2 >> latitude1 >> longitude1 >> latitude2 >> longitude2;
+			int start = addNode(GeoCoord(latitude1, longitude1));
+			int end = addNode(GeoCoord(latitude2, longitude2));
+			sources.push_back(start);
+			targets.push_back(end);
+			names.push_back(nameId);
+			sources.push_back(end);		//do the same with the reversed segment
+			targets.push_back(start);
+			names.push_back(nameId);
+		}
+	}
+
+	//counting sort the edges by start node; this is stable, so each node keeps its file order
+	int numNodes = m_coords.size();
+	m_firstEdge.assign(numNodes + 1, 0);
+	for (int i = 0; i < sources.size(); i++)
+		m_firstEdge[sources[i] + 1]++;
+	for (int i = 0; i < numNodes; i++)
+		m_firstEdge[i + 1] += m_firstEdge[i];
+	vector<int> nextSlot(m_firstEdge.begin(), m_firstEdge.end() - 1);
+	m_edgeSource.resize(sources.size());
+	m_edgeTarget.resize(sources.size());
+	m_edgeLength.resize(sources.size());
+	m_edgeName.resize(sources.size());
+	for (int i = 0; i < sources.size(); i++)
+	{
+		int slot = nextSlot[sources[i]]++;
+		m_edgeSource[slot] = sources[i];
+		m_edgeTarget[slot] = targets[i];
+		m_edgeLength[slot] = distanceEarthMiles(m_coords[sources[i]], m_coords[targets[i]]);
+		m_edgeName[slot] = names[i];
+	}
+
+	labelComponents();
+	reorder(order);
+	return true;
+}
+
+int StreetGraph::findNode(const GeoCoord& gc) const
+{
+	const int* node = m_nodeIds.find(gc);
+	if (node == nullptr)
+		return -1;
+	return *node;
+}
+
+StreetSegment StreetGraph::segment(int edge) const
+{
+	return StreetSegment(m_coords[m_edgeSource[edge]], m_coords[m_edgeTarget[edge]], m_names[m_edgeName[edge]]);
+}
+
+int StreetGraph::reverseEdge(int edge) const
+{
+	int source = m_edgeSource[edge];
+	int target = m_edgeTarget[edge];
+	for (int e = m_firstEdge[target]; e < m_firstEdge[target + 1]; e++)
+		if (m_edgeTarget[e] == source && m_edgeName[e] == m_edgeName[edge])
+			return e;
+	return -1;
+}
+
+//FNV-1a over the node numbering and the edges
+unsigned long long StreetGraph::checksum() const
+{
+	unsigned long long hash = 14695981039346656037ULL;
+	auto mix = [&hash](unsigned long long value)
+	{
+		for (int i = 0; i < 8; i++)
+		{
+			hash ^= (value >> (8 * i)) & 0xff;
+			hash *= 1099511628211ULL;
+		}
+	};
+	mix(nodeCount());
+	mix(edgeCount());
+	for (int n = 0; n < nodeCount(); n++)
+	{
+		mix((unsigned long long)llround(latitude(n) * 1e7));
+		mix((unsigned long long)llround(longitude(n) * 1e7));
+		mix(firstEdge(n));
+	}
+	for (int e = 0; e < edgeCount(); e++)
+		mix(edgeTarget(e));
+	return hash;
+}
+
+size_t StreetGraph::bytes() const
+{
+	size_t total = m_coords.capacity() * sizeof(GeoCoord);
+	for (int i = 0; i < m_coords.size(); i++)	//texts too long for the string's own buffer
+	{
+		if (m_coords[i].latitudeText.capacity() > 15)
+			total += m_coords[i].latitudeText.capacity() + 1;
+		if (m_coords[i].longitudeText.capacity() > 15)
+			total += m_coords[i].longitudeText.capacity() + 1;
+	}
+	total += (m_latitudes.capacity() + m_longitudes.capacity()) * sizeof(double);
+	total += (m_components.capacity() + m_firstEdge.capacity()) * sizeof(int);
+	total += (m_edgeSource.capacity() + m_edgeTarget.capacity() + m_edgeName.capacity()) * sizeof(int);
+	total += m_edgeLength.capacity() * sizeof(double);
+	for (int i = 0; i < m_names.size(); i++)
+		total += sizeof(string) + (m_names[i].capacity() > 15 ? m_names[i].capacity() + 1 : 0);
+	//each entry of the coord lookup is a list node holding a coord and a number, at most one
+	//bucket list, and two bucket pointers at a load factor of 0.5
+	total += m_nodeIds.size() * (sizeof(GeoCoord) + sizeof(int) + 2 * sizeof(void*) + sizeof(list<int>) + 2 * sizeof(void*));
+	return total;
+}
+
+int StreetGraph::addNode(const GeoCoord& gc)
+{
+	const int* node = m_nodeIds.find(gc);
+	if (node != nullptr)
+		return *node;
+	int newNode = m_coords.size();
+	m_nodeIds.associate(gc, newNode);
+	m_coords.push_back(gc);
+	m_latitudes.push_back(gc.latitude);
+	m_longitudes.push_back(gc.longitude);
+	return newNode;
+}
+
+//flood fill every node so that unreachable pairs can be rejected without searching
+void StreetGraph::labelComponents()
+{
+	m_components.assign(m_coords.size(), -1);
+	int label = 0;
+	vector<int> toVisit;
+	for (int i = 0; i < m_coords.size(); i++)
+	{
+		if (m_components[i] != -1)	//already reached from an earlier node
+			continue;
+		m_components[i] = label;
+		toVisit.push_back(i);
+		while (!toVisit.empty())
+		{
+			int current = toVisit.back();
+			toVisit.pop_back();
+			for (int e = m_firstEdge[current]; e < m_firstEdge[current + 1]; e++)
+			{
+				int next = m_edgeTarget[e];
+				if (m_components[next] == -1)
+				{
+					m_components[next] = label;
+					toVisit.push_back(next);
+				}
+			}
+		}
+		label++;
+	}
+}
+
+void StreetGraph::reorder(NodeOrder order)
+{
+	if (order == HILBERT_ORDER)
+		applyOrder(hilbertOrder());
+	else if (order == CUTHILL_MCKEE_ORDER)
+		applyOrder(cuthillMcKeeOrder());
+}
+
+//sort nodes by their position along a Hilbert curve over the map's bounding box
+vector<int> StreetGraph::hilbertOrder() const
+{
+	vector<int> order(m_coords.size());
+	if (order.empty())
+		return order;
+	double minLat = *min_element(m_latitudes.begin(), m_latitudes.end());
+	double maxLat = *max_element(m_latitudes.begin(), m_latitudes.end());
+	double minLon = *min_element(m_longitudes.begin(), m_longitudes.end());
+	double maxLon = *max_element(m_longitudes.begin(), m_longitudes.end());
+	vector<unsigned long long> keys(m_coords.size());
+	for (int i = 0; i < m_coords.size(); i++)
+	{
+		order[i] = i;
+		keys[i] = hilbertIndex(m_latitudes[i], m_longitudes[i], minLat, maxLat, minLon, maxLon);
+	}
+	stable_sort(order.begin(), order.end(), [&keys](int a, int b) { return keys[a] < keys[b]; });
+	return order;
+}
+
+//reverse Cuthill-McKee: breadth first from a low degree node, visiting lower degree neighbours first
+vector<int> StreetGraph::cuthillMcKeeOrder() const
+{
+	int numNodes = m_coords.size();
+	vector<int> byDegree(numNodes);
+	for (int i = 0; i < numNodes; i++)
+		byDegree[i] = i;
+	auto degree = [this](int node) { return m_firstEdge[node + 1] - m_firstEdge[node]; };
+	stable_sort(byDegree.begin(), byDegree.end(), [&degree](int a, int b) { return degree(a) < degree(b); });
+
+	vector<int> order;
+	order.reserve(numNodes);
+	vector<bool> placed(numNodes, false);
+	vector<int> neighbours;
+	for (int i = 0; i < numNodes; i++)
+	{
+		if (placed[byDegree[i]])
+			continue;
+		int head = order.size();	//start a new breadth first search for each component
+		order.push_back(byDegree[i]);
+		placed[byDegree[i]] = true;
+		for (; head < order.size(); head++)
+		{
+			int current = order[head];
+			neighbours.clear();
+			for (int e = m_firstEdge[current]; e < m_firstEdge[current + 1]; e++)
+			{
+				int next = m_edgeTarget[e];
+				if (!placed[next])
+				{
+					placed[next] = true;
+					neighbours.push_back(next);
+				}
+			}
+			stable_sort(neighbours.begin(), neighbours.end(), [&degree](int a, int b) { return degree(a) < degree(b); });
+			order.insert(order.end(), neighbours.begin(), neighbours.end());
+		}
+	}
+	reverse(order.begin(), order.end());
+	return order;
+}
+
+//order[newNode] is the old number of that node; every per-node and per-edge array is permuted to match
+void StreetGraph::applyOrder(const vector<int>& order)
+{
+	int numNodes = order.size();
+	vector<int> newIds(numNodes);
+	for (int i = 0; i < numNodes; i++)
+		newIds[order[i]] = i;
+
+	vector<GeoCoord> coords(numNodes);
+	vector<double> latitudes(numNodes);
+	vector<double> longitudes(numNodes);
+	vector<int> components(numNodes);
+	vector<int> firstEdge(numNodes + 1, 0);
+	vector<int> edgeSource;
+	vector<int> edgeTarget;
+	vector<double> edgeLength;
+	vector<int> edgeName;
+	edgeSource.reserve(m_edgeSource.size());
+	edgeTarget.reserve(m_edgeTarget.size());
+	edgeLength.reserve(m_edgeLength.size());
+	edgeName.reserve(m_edgeName.size());
+	for (int i = 0; i < numNodes; i++)
+	{
+		int old = order[i];
+		coords[i] = m_coords[old];
+		latitudes[i] = m_latitudes[old];
+		longitudes[i] = m_longitudes[old];
+		components[i] = m_components[old];
+		firstEdge[i] = edgeTarget.size();
+		for (int e = m_firstEdge[old]; e < m_firstEdge[old + 1]; e++)
+		{
+			edgeSource.push_back(i);
+			edgeTarget.push_back(newIds[m_edgeTarget[e]]);
+			edgeLength.push_back(m_edgeLength[e]);
+			edgeName.push_back(m_edgeName[e]);
+		}
+		*(m_nodeIds.find(coords[i])) = i;
+	}
+	firstEdge[numNodes] = edgeTarget.size();
+
+	m_coords.swap(coords);
+	m_latitudes.swap(latitudes);
+	m_longitudes.swap(longitudes);
+	m_components.swap(components);
+	m_firstEdge.swap(firstEdge);
+	m_edgeSource.swap(edgeSource);
+	m_edgeTarget.swap(edgeTarget);
+	m_edgeLength.swap(edgeLength);
+	m_edgeName.swap(edgeName);
+}
@@ -0,0 +1,78 @@
+// StreetGraph.h
+
+// Flat array form of the road network that StreetMap loads.  Every coord is a node
+// numbered 0..nodeCount()-1 and every street segment (in both directions) is an edge.
+// The edges leaving a node are stored next to each other, from firstEdge(node) up to
+// but not including firstEdge(node + 1), in the order they appeared in the map file.
+#ifndef STREETGRAPH_INCLUDED
+#define STREETGRAPH_INCLUDED
+
+#include <string>
+#include <vector>
+#include "provided.h"
+#include "ExpandableHashMap.h"
+
+class StreetGraph
+{
+public:
+	StreetGraph();
+	bool load(std::string mapFile, NodeOrder order);
+
+	int nodeCount() const { return m_coords.size(); }
+	int edgeCount() const { return m_edgeTarget.size(); }
+
+	  // returns -1 if the coord is not on the map
+	int findNode(const GeoCoord& gc) const;
+
+	const GeoCoord& coord(int node) const { return m_coords[node]; }
+	double latitude(int node) const { return m_latitudes[node]; }
+	double longitude(int node) const { return m_longitudes[node]; }
+	int component(int node) const { return m_components[node]; }
+	int firstEdge(int node) const { return m_firstEdge[node]; }
+
+	int edgeSource(int edge) const { return m_edgeSource[edge]; }
+	int edgeTarget(int edge) const { return m_edgeTarget[edge]; }
+	double edgeLength(int edge) const { return m_edgeLength[edge]; }
+	const std::string& edgeName(int edge) const { return m_names[m_edgeName[edge]]; }
+	  // street names by number, so edges on the same street can be compared cheaply
+	int edgeNameId(int edge) const { return m_edgeName[edge]; }
+	int nameCount() const { return m_names.size(); }
+	const std::string& name(int nameId) const { return m_names[nameId]; }
+	StreetSegment segment(int edge) const;
+	  // the same street segment driven the other way
+	int reverseEdge(int edge) const;
+
+	  // memory held by the graph, in bytes; the coord lookup table is estimated
+	size_t bytes() const;
+	  // identifies the graph, node numbering included, so data built for one graph is
+	  // never used with another, or with the same map loaded in a different node order
+	unsigned long long checksum() const;
+
+	  // renumber the nodes so that nodes near each other in memory are near each other on the map
+	void reorder(NodeOrder order);
+
+	StreetGraph(const StreetGraph&) = delete;
+	StreetGraph& operator=(const StreetGraph&) = delete;
+
+private:
+	//location : node number
+	ExpandableHashMap<GeoCoord, int> m_nodeIds;
+	std::vector<GeoCoord> m_coords;
+	std::vector<double> m_latitudes;
+	std::vector<double> m_longitudes;
+	std::vector<int> m_components;
+	std::vector<int> m_firstEdge;
+	std::vector<int> m_edgeSource;
+	std::vector<int> m_edgeTarget;
+	std::vector<double> m_edgeLength;
+	std::vector<int> m_edgeName;
+	std::vector<std::string> m_names;
+
+	int addNode(const GeoCoord& gc);
+	void labelComponents();
+	std::vector<int> hilbertOrder() const;
+	std::vector<int> cuthillMcKeeOrder() const;
+	void applyOrder(const std::vector<int>& order);
+};
+
+#endif // STREETGRAPH_INCLUDED
@@ -3,9 +3,11 @@
 #include <vector>
 #include <functional>
 #include <iostream>
-#include <fstream>
-#include <sstream>
-#include "ExpandableHashMap.h"
+#include <memory>
+#include <mutex>
+#include <cmath>
+#include "MapSnapshot.h"
+#include "HubOracle.h"
 using namespace std;
 
 unsigned int hasher(const GeoCoord& g)
@@ -18,10 +20,17 @@ class StreetMapImpl
 public:
     StreetMapImpl();
     ~StreetMapImpl();
-    bool load(string mapFile);
+    bool load(string mapFile, NodeOrder order);
     bool getSegmentsThatStartWith(const GeoCoord& gc, vector<StreetSegment>& segs) const;
+    bool getComponent(const GeoCoord& gc, int& component) const;
+    shared_ptr<const MapSnapshot> getSnapshot() const;
+    bool applyEdgeWeights(const vector<EdgeWeightUpdate>& updates);
+    bool loadHubs(string hubFile);
 private:
-	ExpandableHashMap<GeoCoord, vector<StreetSegment>> m_streetMap;
+	//only ever read or replaced with atomic_load and atomic_store
+	shared_ptr<const MapSnapshot> m_current;
+	//one load or weight update publishes at a time so versions go up in order
+	mutex m_loadMutex;
 };
 
 StreetMapImpl::StreetMapImpl()
@@ -32,83 +41,121 @@ StreetMapImpl::~StreetMapImpl()
 {
 }
 
-bool StreetMapImpl::load(string mapFile)
+bool StreetMapImpl::load(string mapFile, NodeOrder order)
 {
-	ifstream inf(mapFile);	//read in mapfile
-	if (!inf)			//return false if could not be read in
+	shared_ptr<StreetGraph> graph = make_shared<StreetGraph>();	//build the new map off to the side while readers use the current one
+	if (!graph->load(mapFile, order))
 		return false;
-	string line;
-	
-	while (getline(inf, line))
-	{
-		istringstream iss(line);
-		
-		string name;
-		int numCoords;
 
-		name = iss.str();	//if there is an empty line at the end of the file, break
-		if (name == "")
-			break;
+	lock_guard<mutex> lock(m_loadMutex);
+	shared_ptr<const MapSnapshot> current = atomic_load(&m_current);
+	shared_ptr<MapSnapshot> snapshot = make_shared<MapSnapshot>();
+	snapshot->graph = graph;
+	snapshot->weights = make_shared<EdgeWeights>();
+	snapshot->version = current == nullptr ? 1 : current->version + 1;
+	atomic_store(&m_current, shared_ptr<const MapSnapshot>(snapshot));
+	return true;
+}
+
+bool StreetMapImpl::getSegmentsThatStartWith(const GeoCoord& gc, vector<StreetSegment>& segs) const
+{
+	shared_ptr<const MapSnapshot> map = getSnapshot();
+	if (map == nullptr)
+		return false;
+	const StreetGraph& graph = *map->graph;
+	int node = graph.findNode(gc);	//find node asssociated with coord
+	if (node == -1)
+		return false;
+	segs.erase(segs.begin(), segs.end());
+	for (int e = graph.firstEdge(node); e < graph.firstEdge(node + 1); e++)	//place edges leaving the node into segs
+	{
+		segs.push_back(graph.segment(e));
+	}
+	return true;
+}
 
-		if (!getline(inf, line))	
-			return false;
+bool StreetMapImpl::getComponent(const GeoCoord& gc, int& component) const
+{
+	shared_ptr<const MapSnapshot> map = getSnapshot();
+	if (map == nullptr)
+		return false;
+	int node = map->graph->findNode(gc);
+	if (node == -1)
+		return false;
+	component = map->graph->component(node);
+	return true;
+}
 
-		istringstream iss2(line);	//number following should be how many line segments follow the name
+shared_ptr<const MapSnapshot> StreetMapImpl::getSnapshot() const
+{
+	return atomic_load(&m_current);
+}
 
-		iss2 >> numCoords;
+//the graph is shared with the current version; only the changed weight pages are copied
+bool StreetMapImpl::applyEdgeWeights(const vector<EdgeWeightUpdate>& updates)
+{
+	lock_guard<mutex> lock(m_loadMutex);
+	shared_ptr<const MapSnapshot> current = atomic_load(&m_current);
+	if (current == nullptr || current->graph->edgeCount() > EdgeWeights::MAX_EDGES)
+		return false;
+	const StreetGraph& graph = *current->graph;
 
-		for (int i = 0; i < numCoords; i++)	//for the number of line segments, convert the strings into streetsegments
+	bool allFound = true;
+	vector<pair<int, double>> changes;
+	for (int i = 0; i < updates.size(); i++)
+	{
+		double multiplier = updates[i].closed ? HUGE_VAL : updates[i].costMultiplier;
+		if (!(multiplier >= 0))	//a negative cost would let routes loop forever
 		{
-			if (!getline(inf, line))
-				return false;
-			istringstream iss3(line);
-			string latitude1;
-			string longitude1;
-			string latitude2;
-			string longitude2;
-			iss3 >> latitude1 >> longitude1 >> latitude2 >> longitude2;
-			GeoCoord start(latitude1, longitude1);
-			GeoCoord end(latitude2, longitude2);
-			StreetSegment s(start, end, name);
-			vector<StreetSegment>* sVector = m_streetMap.find(start);
-			if (sVector != nullptr)	//if a geocoord already has associated streetsegments, add the segment to it
-			{
-				sVector->push_back(s);
-			}
-			else                           //if not, create a new vector of streetsegments
-			{
-				vector<StreetSegment> newSegment;
-				newSegment.push_back(s);
-				m_streetMap.associate(start, newSegment);
-			}
-			sVector = m_streetMap.find(end);		//do the same with the reversed segments
-			StreetSegment r(end, start, name);
-			if (sVector != nullptr)
-			{
-				sVector->push_back(r);
-			}
-			else
+			allFound = false;
+			continue;
+		}
+		bool found = false;
+		for (int direction = 0; direction < (updates[i].bothDirections ? 2 : 1); direction++)
+		{
+			const GeoCoord& from = direction == 0 ? updates[i].segment.start : updates[i].segment.end;
+			const GeoCoord& to = direction == 0 ? updates[i].segment.end : updates[i].segment.start;
+			int node = graph.findNode(from);
+			if (node == -1)
+				continue;
+			for (int e = graph.firstEdge(node); e < graph.firstEdge(node + 1); e++)	//every street drawn along this segment
 			{
-				vector<StreetSegment> newSegment;
-				newSegment.push_back(r);
-				m_streetMap.associate(end, newSegment);
+				if (graph.coord(graph.edgeTarget(e)) == to)
+				{
+					changes.push_back(make_pair(e, multiplier));
+					found = true;
+				}
 			}
-
 		}
+		if (!found)
+			allFound = false;
 	}
-	return true;
+
+	if (changes.empty())	//nothing changed, so there is no new version to publish
+		return allFound;
+	shared_ptr<MapSnapshot> snapshot = make_shared<MapSnapshot>();
+	snapshot->graph = current->graph;
+	snapshot->weights = current->weights->withChanges(changes);
+	snapshot->hubs = current->hubs;
+	snapshot->version = current->version + 1;
+	atomic_store(&m_current, shared_ptr<const MapSnapshot>(snapshot));
+	return allFound;
 }
 
-bool StreetMapImpl::getSegmentsThatStartWith(const GeoCoord& gc, vector<StreetSegment>& segs) const
+bool StreetMapImpl::loadHubs(string hubFile)
 {
-	const vector<StreetSegment>* segVector = m_streetMap.find(gc);	//find vector asssociated with coord
-	if (segVector == nullptr)
+	lock_guard<mutex> lock(m_loadMutex);
+	shared_ptr<const MapSnapshot> current = atomic_load(&m_current);
+	if (current == nullptr)
 		return false;
-	segs.erase(segs.begin(), segs.end());
-	for (int i = 0; i < segVector->size(); i++)		//place associated segments into segs
-	{
-		segs.push_back((*segVector)[i]);
-	}
+	shared_ptr<HubOracle> hubs = make_shared<HubOracle>();
+	if (!hubs->load(hubFile, *current->graph))
+		return false;
+
+	shared_ptr<MapSnapshot> snapshot = make_shared<MapSnapshot>(*current);
+	snapshot->hubs = hubs;
+	snapshot->version = current->version + 1;
+	atomic_store(&m_current, shared_ptr<const MapSnapshot>(snapshot));
 	return true;
 }
 
@@ -127,12 +174,32 @@ StreetMap::~StreetMap()
     delete m_impl;
 }
 
-bool StreetMap::load(string mapFile)
+bool StreetMap::load(string mapFile, NodeOrder order)
 {
-    return m_impl->load(mapFile);
+    return m_impl->load(mapFile, order);
 }
 
 bool StreetMap::getSegmentsThatStartWith(const GeoCoord& gc, vector<StreetSegment>& segs) const
 {
    return m_impl->getSegmentsThatStartWith(gc, segs);
 }
+
+bool StreetMap::getComponent(const GeoCoord& gc, int& component) const
+{
+   return m_impl->getComponent(gc, component);
+}
+
+shared_ptr<const MapSnapshot> StreetMap::getSnapshot() const
+{
+   return m_impl->getSnapshot();
+}
+
+bool StreetMap::applyEdgeWeights(const vector<EdgeWeightUpdate>& updates)
+{
+   return m_impl->applyEdgeWeights(updates);
+}
+
+bool StreetMap::loadHubs(string hubFile)
+{
+   return m_impl->loadHubs(hubFile);
+}
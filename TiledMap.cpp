@@ -0,0 +1,288 @@
+#include "provided.h"
+#include "TiledMap.h"
+#include "StreetGraph.h"
+#include "HilbertCurve.h"
+#include "ByteBuffer.h"
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+//identifies a tiled map file, and which version of the layout it uses
+const uint32_t TILE_FILE_MAGIC = 0x314c4954;	//"TIL1"
+
+TiledMap::TiledMap()
+{
+	m_nodeCount = 0;
+	m_minLat = m_maxLat = m_minLon = m_maxLon = 0;
+	m_maxResident = 1;
+	m_tilesRead = 0;
+}
+
+bool TiledMap::write(const StreetGraph& graph, int nodesPerTile, string tileFile)
+{
+	int numNodes = graph.nodeCount();
+	if (numNodes == 0 || nodesPerTile < 1)
+		return false;
+	double minLat = graph.latitude(0);
+	double maxLat = minLat;
+	double minLon = graph.longitude(0);
+	double maxLon = minLon;
+	for (int n = 0; n < numNodes; n++)
+	{
+		minLat = min(minLat, graph.latitude(n));
+		maxLat = max(maxLat, graph.latitude(n));
+		minLon = min(minLon, graph.longitude(n));
+		maxLon = max(maxLon, graph.longitude(n));
+	}
+	vector<unsigned long long> keys(numNodes);
+	for (int n = 0; n < numNodes; n++)
+	{
+		keys[n] = hilbertIndex(graph.latitude(n), graph.longitude(n), minLat, maxLat, minLon, maxLon);
+		if (n > 0 && keys[n] < keys[n - 1])	//not numbered along the curve
+			return false;
+	}
+
+	//cut the curve into tiles, but never between nodes with the same key, so findNode
+	//only ever has to look in one tile
+	vector<int> tileStarts;
+	for (int n = 0; n < numNodes; n++)
+		if (tileStarts.empty() || (n - tileStarts.back() >= nodesPerTile && keys[n] != keys[n - 1]))
+			tileStarts.push_back(n);
+	tileStarts.push_back(numNodes);
+
+	vector<string> blobs;
+	for (int t = 0; t + 1 < tileStarts.size(); t++)
+	{
+		ByteWriter tile;
+		int first = tileStarts[t];
+		int last = tileStarts[t + 1];
+		tile.put<uint32_t>(last - first);
+		tile.put<uint32_t>(graph.firstEdge(last) - graph.firstEdge(first));
+		for (int n = first; n < last; n++)
+		{
+			const GeoCoord& gc = graph.coord(n);
+			if (gc.latitudeText.size() > 255 || gc.longitudeText.size() > 255)
+				return false;
+			tile.putText(gc.latitudeText, false);
+			tile.putText(gc.longitudeText, false);
+			tile.put<uint64_t>(keys[n]);
+			tile.put<uint32_t>(graph.component(n));
+			tile.put<uint32_t>(graph.firstEdge(n) - graph.firstEdge(first));
+		}
+		tile.put<uint32_t>(graph.firstEdge(last) - graph.firstEdge(first));
+		vector<string> tileNames;	//names used in this tile, in order of first use
+		unordered_map<string, int> nameIds;
+		for (int e = graph.firstEdge(first); e < graph.firstEdge(last); e++)
+		{
+			auto inserted = nameIds.insert(make_pair(graph.edgeName(e), (int)tileNames.size()));
+			if (inserted.second)
+				tileNames.push_back(graph.edgeName(e));
+			int name = inserted.first->second;
+			tile.put<uint32_t>(graph.edgeTarget(e));
+			tile.put<double>(graph.edgeLength(e));
+			tile.put<uint32_t>(name);
+		}
+		tile.put<uint32_t>(tileNames.size());
+		for (int i = 0; i < tileNames.size(); i++)
+			tile.putText(tileNames[i], true);
+		blobs.push_back(tile.bytes());
+	}
+
+	ByteWriter header;
+	header.put<uint32_t>(TILE_FILE_MAGIC);
+	header.put<uint32_t>(numNodes);
+	header.put<uint32_t>(blobs.size());
+	header.put<double>(minLat);
+	header.put<double>(maxLat);
+	header.put<double>(minLon);
+	header.put<double>(maxLon);
+	size_t indexEntrySize = sizeof(uint64_t) + sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint32_t);
+	uint64_t offset = header.bytes().size() + blobs.size() * indexEntrySize;
+	for (int t = 0; t < blobs.size(); t++)
+	{
+		header.put<uint64_t>(keys[tileStarts[t]]);
+		header.put<uint32_t>(tileStarts[t]);
+		header.put<uint64_t>(offset);
+		header.put<uint32_t>(blobs[t].size());
+		offset += blobs[t].size();
+	}
+
+	ofstream outf(tileFile, ios::binary);
+	if (!outf)
+		return false;
+	outf.write(header.bytes().data(), header.bytes().size());
+	for (int t = 0; t < blobs.size(); t++)
+		outf.write(blobs[t].data(), blobs[t].size());
+	return bool(outf);
+}
+
+bool TiledMap::open(string tileFile, int maxResidentTiles)
+{
+	lock_guard<mutex> lock(m_cacheMutex);
+	m_file.close();
+	m_file.clear();
+	m_file.open(tileFile, ios::binary);
+	if (!m_file)
+		return false;
+	auto get = [this](void* data, size_t size) { return bool(m_file.read(static_cast<char*>(data), size)); };
+	uint32_t magic = 0;
+	uint32_t numNodes = 0;
+	uint32_t numTiles = 0;
+	if (!get(&magic, sizeof(magic)) || magic != TILE_FILE_MAGIC || !get(&numNodes, sizeof(numNodes)) || !get(&numTiles, sizeof(numTiles))
+		|| !get(&m_minLat, sizeof(double)) || !get(&m_maxLat, sizeof(double)) || !get(&m_minLon, sizeof(double)) || !get(&m_maxLon, sizeof(double)))
+		return false;
+	vector<TileEntry> index(numTiles);
+	for (int t = 0; t < numTiles; t++)
+	{
+		uint64_t firstKey = 0;
+		uint32_t firstNode = 0;
+		uint64_t offset = 0;
+		uint32_t size = 0;
+		if (!get(&firstKey, sizeof(firstKey)) || !get(&firstNode, sizeof(firstNode)) || !get(&offset, sizeof(offset)) || !get(&size, sizeof(size)))
+			return false;
+		index[t].firstKey = firstKey;
+		index[t].firstNode = firstNode;
+		index[t].offset = offset;
+		index[t].size = size;
+	}
+
+	m_index.swap(index);
+	m_nodeCount = numNodes;
+	m_maxResident = max(1, maxResidentTiles);
+	m_resident.assign(numTiles, nullptr);
+	m_recent.clear();
+	m_recentPosition.assign(numTiles, m_recent.end());
+	m_tilesRead = 0;
+	return true;
+}
+
+int TiledMap::tileOf(int node) const
+{
+	auto after = upper_bound(m_index.begin(), m_index.end(), node,
+		[](int n, const TileEntry& entry) { return n < entry.firstNode; });
+	return (after - m_index.begin()) - 1;
+}
+
+shared_ptr<const MapTile> TiledMap::tile(int t) const
+{
+	lock_guard<mutex> lock(m_cacheMutex);
+	if (m_resident[t] != nullptr)	//move it to the front of the line
+	{
+		m_recent.splice(m_recent.begin(), m_recent, m_recentPosition[t]);
+		return m_resident[t];
+	}
+
+	shared_ptr<const MapTile> loaded = readTile(t);
+	if (loaded == nullptr)
+		return nullptr;
+	m_tilesRead++;
+	if (m_recent.size() >= m_maxResident)	//make room by dropping the least recently used
+	{
+		int oldest = m_recent.back();
+		m_recent.pop_back();
+		m_resident[oldest] = nullptr;
+		m_recentPosition[oldest] = m_recent.end();
+	}
+	m_recent.push_front(t);
+	m_recentPosition[t] = m_recent.begin();
+	m_resident[t] = loaded;
+	return loaded;
+}
+
+//called with m_cacheMutex held
+shared_ptr<const MapTile> TiledMap::readTile(int t) const
+{
+	string bytes(m_index[t].size, '\0');
+	m_file.clear();
+	m_file.seekg(m_index[t].offset);
+	if (!m_file.read(&bytes[0], bytes.size()))
+		return nullptr;
+
+	ByteReader reader(bytes);
+	shared_ptr<MapTile> tile = make_shared<MapTile>();
+	tile->firstNode = m_index[t].firstNode;
+	uint32_t numNodes = 0;
+	uint32_t numEdges = 0;
+	if (!reader.get(numNodes) || !reader.get(numEdges))
+		return nullptr;
+	tile->coords.reserve(numNodes);
+	tile->keys.resize(numNodes);
+	tile->components.resize(numNodes);
+	tile->firstEdge.resize(numNodes + 1);
+	for (int i = 0; i < numNodes; i++)
+	{
+		string lat;
+		string lon;
+		uint64_t key = 0;
+		uint32_t component = 0;
+		uint32_t firstEdge = 0;
+		if (!reader.getText(lat, false) || !reader.getText(lon, false) || !reader.get(key) || !reader.get(component) || !reader.get(firstEdge))
+			return nullptr;
+		tile->coords.push_back(GeoCoord(lat, lon));
+		tile->keys[i] = key;
+		tile->components[i] = component;
+		tile->firstEdge[i] = firstEdge;
+	}
+	uint32_t sentinel = 0;
+	if (!reader.get(sentinel))
+		return nullptr;
+	tile->firstEdge[numNodes] = sentinel;
+	tile->edgeTarget.resize(numEdges);
+	tile->edgeLength.resize(numEdges);
+	tile->edgeName.resize(numEdges);
+	for (int e = 0; e < numEdges; e++)
+	{
+		uint32_t target = 0;
+		double length = 0;
+		uint32_t name = 0;
+		if (!reader.get(target) || !reader.get(length) || !reader.get(name))
+			return nullptr;
+		tile->edgeTarget[e] = target;
+		tile->edgeLength[e] = length;
+		tile->edgeName[e] = name;
+	}
+	uint32_t numNames = 0;
+	if (!reader.get(numNames))
+		return nullptr;
+	tile->names.resize(numNames);
+	for (int i = 0; i < numNames; i++)
+		if (!reader.getText(tile->names[i], true))
+			return nullptr;
+	return tile;
+}
+
+int TiledMap::findNode(const GeoCoord& gc) const
+{
+	if (m_index.empty())
+		return -1;
+	unsigned long long key = hilbertIndex(gc.latitude, gc.longitude, m_minLat, m_maxLat, m_minLon, m_maxLon);
+	auto after = upper_bound(m_index.begin(), m_index.end(), key,
+		[](unsigned long long k, const TileEntry& entry) { return k < entry.firstKey; });
+	if (after == m_index.begin())
+		return -1;
+	shared_ptr<const MapTile> found = tile((after - m_index.begin()) - 1);
+	if (found == nullptr)
+		return -1;
+	//nodes are sorted by key, so only the ones sharing this key need comparing
+	auto first = lower_bound(found->keys.begin(), found->keys.end(), key);
+	for (int i = first - found->keys.begin(); i < found->nodeCount() && found->keys[i] == key; i++)
+		if (found->coords[i] == gc)
+			return found->firstNode + i;
+	return -1;
+}
+
+int TiledMap::tilesRead() const
+{
+	lock_guard<mutex> lock(m_cacheMutex);
+	return m_tilesRead;
+}
+
+int TiledMap::residentTiles() const
+{
+	lock_guard<mutex> lock(m_cacheMutex);
+	return m_recent.size();
+}
@@ -0,0 +1,103 @@
+// TiledMap.h
+
+// A road network kept on disk in geographic tiles and read a tile at a time, so maps far
+// bigger than memory can be routed over.  tools/BuildTiles writes the file from a map
+// data file: nodes are numbered along a Hilbert curve and the curve is cut into runs of
+// about the same number of nodes, which makes every tile a compact patch of the map.  An
+// edge that leaves its tile just names a node of another tile (a boundary node), so a
+// search crosses into the next tile by reading it.
+//
+// Opening a tiled map reads only the header and the tile index.  Tiles are read when a
+// search first needs them and kept in a least recently used cache of at most
+// maxResidentTiles; a tile a search still holds stays in memory until it lets go.
+#ifndef TILEDMAP_INCLUDED
+#define TILEDMAP_INCLUDED
+
+#include <fstream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "provided.h"
+
+class StreetGraph;
+
+  // One tile: nodes firstNode up to firstNode + nodeCount() - 1 and the edges leaving
+  // them.  Per-node and per-edge arrays are indexed by the number within the tile.
+struct MapTile
+{
+	int firstNode;
+	std::vector<GeoCoord> coords;
+	std::vector<unsigned long long> keys;
+	std::vector<int> components;
+	  // edges of local node i run from firstEdge[i] up to but not including firstEdge[i + 1]
+	std::vector<int> firstEdge;
+	  // map wide node numbers, which may be in another tile
+	std::vector<int> edgeTarget;
+	std::vector<double> edgeLength;
+	std::vector<int> edgeName;
+	std::vector<std::string> names;
+
+	int nodeCount() const { return coords.size(); }
+	int local(int node) const { return node - firstNode; }
+};
+
+class TiledMap
+{
+public:
+	TiledMap();
+	bool open(std::string tileFile, int maxResidentTiles);
+
+	  // write graph, which must have been loaded in HILBERT_ORDER, as tiles of about
+	  // nodesPerTile nodes
+	static bool write(const StreetGraph& graph, int nodesPerTile, std::string tileFile);
+
+	int nodeCount() const { return m_nodeCount; }
+	int tileCount() const { return m_index.size(); }
+	  // the tile holding node
+	int tileOf(int node) const;
+	  // read the tile if it isn't resident; null if it can't be read
+	std::shared_ptr<const MapTile> tile(int t) const;
+	  // returns -1 if the coord is not on the map; reads at most one tile
+	int findNode(const GeoCoord& gc) const;
+
+	  // how many times a tile has been read from disk, and how many are in memory now
+	int tilesRead() const;
+	int residentTiles() const;
+
+	TiledMap(const TiledMap&) = delete;
+	TiledMap& operator=(const TiledMap&) = delete;
+
+private:
+	struct TileEntry
+	{
+		unsigned long long firstKey;
+		int firstNode;
+		long long offset;
+		int size;
+	};
+
+	std::vector<TileEntry> m_index;
+	int m_nodeCount;
+	double m_minLat;
+	double m_maxLat;
+	double m_minLon;
+	double m_maxLon;
+	int m_maxResident;
+
+	//everything below is guarded by m_cacheMutex, including reads of m_file
+	mutable std::mutex m_cacheMutex;
+	mutable std::ifstream m_file;
+	//tile : the tile, or null if it isn't resident
+	mutable std::vector<std::shared_ptr<const MapTile>> m_resident;
+	//resident tiles, most recently used first
+	mutable std::list<int> m_recent;
+	//tile : its place in m_recent
+	mutable std::vector<std::list<int>::iterator> m_recentPosition;
+	mutable int m_tilesRead;
+
+	std::shared_ptr<const MapTile> readTile(int t) const;
+};
+
+#endif // TILEDMAP_INCLUDED
@@ -1,19 +1,49 @@
 #include "provided.h"
+#include "PlanningServer.h"
+#include "ManifestReader.h"
+#include "QueryLog.h"
+#include "PlanCache.h"
 #include <iostream>
-#include <fstream>
-#include <sstream>
 #include <string>
 #include <vector>
+#include <cstdlib>
+#include <thread>
 using namespace std;
 
-bool loadDeliveryRequests(string deliveriesFile, GeoCoord& depot, vector<DeliveryRequest>& v);
-bool parseDelivery(string line, string& lat, string& lon, string& item);
+int serve(string mapFile, int numWorkers, string logFile, string cacheDirectory);
+
+  // prints each command as soon as the planner produces it, after the heading
+class PrintingSink : public DeliveryCommandSink
+{
+public:
+    PrintingSink(ostream& out) : m_out(out), m_started(false) {}
+    void receive(const DeliveryCommand& command)
+    {
+        start();
+        command.writeDescription(m_out);
+        m_out << '\n';
+    }
+    void start()
+    {
+        if (!m_started)
+            m_out << "Starting at the depot...\n";
+        m_started = true;
+    }
+private:
+    ostream& m_out;
+    bool m_started;
+};
 
 int main(int argc, char *argv[])
 {
-    if (argc != 3)
+    if (argc >= 3 && argc <= 6 && string(argv[1]) == "--serve")
+        return serve(argv[2], argc >= 4 ? atoi(argv[3]) : thread::hardware_concurrency(), argc >= 5 ? argv[4] : "",
+            argc == 6 ? argv[5] : "");
+
+    if (argc != 3 && argc != 4)
     {
-        cout << "Usage: " << argv[0] << " mapdata.txt deliveries.txt" << endl;
+        cout << "Usage: " << argv[0] << " mapdata.txt deliveries.txt [hubs.bin]" << endl;
+        cout << "       " << argv[0] << " --serve mapdata.txt [workers] [querylog] [plancache]" << endl;
         return 1;
     }
 
@@ -24,21 +54,26 @@ int main(int argc, char *argv[])
         cout << "Unable to load map data file " << argv[1] << endl;
         return 1;
     }
+    if (argc == 4 && !sm.loadHubs(argv[3]))
+    {
+        cout << "Unable to load hub file " << argv[3] << endl;
+        return 1;
+    }
 
-    GeoCoord depot;
-    vector<DeliveryRequest> deliveries;
-    if (!loadDeliveryRequests(argv[2], depot, deliveries))
+    ManifestReader manifest;
+    if (!manifest.read(argv[2], 0))
     {
         cout << "Unable to load delivery request file " << argv[2] << endl;
         return 1;
     }
+    manifest.writeErrors(cout);
 
     cout << "Generating route...\n\n";
 
     DeliveryPlanner dp(&sm);
-    vector<DeliveryCommand> dcs;
+    PrintingSink printer(cout);
     double totalMiles;
-    DeliveryResult result = dp.generateDeliveryPlan(depot, deliveries, dcs, totalMiles);
+    DeliveryResult result = dp.generateDeliveryPlan(manifest.depot(), manifest.deliveries(), printer, totalMiles);
     if (result == BAD_COORD)
     {
         cout << "One or more depot or delivery coordinates are invalid." << endl;
@@ -49,54 +84,50 @@ int main(int argc, char *argv[])
         cout << "No route can be found to deliver all items." << endl;
         return 1;
     }
-    cout << "Starting at the depot...\n";
-    for (const auto& dc : dcs)
-        cout << dc.description() << endl;
+    printer.start();	//a plan with no driving sends no commands
     cout << "You are back at the depot and your deliveries are done!\n";
     cout.setf(ios::fixed);
     cout.precision(2);
     cout << totalMiles << " miles travelled for all deliveries." << endl;
 }
 
-bool loadDeliveryRequests(string deliveriesFile, GeoCoord& depot, vector<DeliveryRequest>& v)
+  // Answer plan requests from standard input until it closes, keeping the map loaded
+  // between them.  Latency statistics go to standard error when done.  If logFile isn't
+  // empty every plan is recorded in it for tools/ReplayLog.  If cacheDirectory isn't
+  // empty plans are cached in memory and kept there, so repeats are answered at once,
+  // even by a later server.
+int serve(string mapFile, int numWorkers, string logFile, string cacheDirectory)
 {
-    ifstream inf(deliveriesFile);
-    if (!inf)
-        return false;
-    string lat;
-    string lon;
-    inf >> lat >> lon;
-    inf.ignore(10000, '\n');
-    depot = GeoCoord(lat, lon);
-    string line;
-    while (getline(inf, line))
-    {
-        string item;
-        if (parseDelivery(line, lat, lon, item))
-            v.push_back(DeliveryRequest(item, GeoCoord(lat, lon)));
-    }
-    return true;
-}
-
-bool parseDelivery(string line, string& lat, string& lon, string& item)
-{
-    const size_t colon = line.find(':');
-    if (colon == string::npos)
+    StreetMap sm;
+    if (!sm.load(mapFile))
     {
-        cout << "Missing colon in deliveries file line: " << line << endl;
-        return false;
+        cerr << "Unable to load map data file " << mapFile << endl;
+        return 1;
     }
-    istringstream iss(line.substr(0, colon));
-    if (!(iss >> lat >> lon))
+    if (numWorkers < 1)
+        numWorkers = 1;
+    QueryLog log;
+    if (logFile != "")
     {
-        cout << "Bad format in deliveries file line: " << line << endl;
-        return false;
+        if (!log.open(logFile))
+        {
+            cerr << "Unable to write query log " << logFile << endl;
+            return 1;
+        }
+        QueryLog::setActive(&log);
     }
-    item = line.substr(colon + 1);
-    if (item.empty())
+    PlanCache cache;
+    if (cacheDirectory != "" && !cache.openDirectory(cacheDirectory))
     {
-        cout << "Missing item in deliveries file line: " << line << endl;
-        return false;
+        cerr << "Unable to use plan cache directory " << cacheDirectory << endl;
+        return 1;
     }
-    return true;
+    PlanningServer server(&sm, numWorkers, 4 * numWorkers, cacheDirectory != "" ? &cache : nullptr);
+    server.serve(cin, cout);
+    QueryLog::setActive(nullptr);	//every plan has been answered, so none is still recording
+    cerr << "Served " << server.stats() << endl;
+    if (cacheDirectory != "")
+        cerr << "Plan cache: " << cache.hits() << " hits, " << cache.diskHits() << " from disk, "
+            << cache.misses() << " misses" << endl;
+    return 0;
 }
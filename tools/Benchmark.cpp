@@ -0,0 +1,1005 @@
+// Benchmark.cpp
+
+// Performance measurements for the routing and planning code.  Build from the
+// repository root with
+//     g++ -std=c++17 -O2 -pthread -o benchmark tools/Benchmark.cpp $(ls *.cpp | grep -v main.cpp)
+// and run "benchmark" with no arguments to list the available measurements.
+
+#include "../provided.h"
+#include "../MapSnapshot.h"
+#include "../RouteSearch.h"
+#include "../HubOracle.h"
+#include "../TiledMap.h"
+#include "../CompressedGraph.h"
+#include "../BatchPlanner.h"
+#include "../ManifestReader.h"
+#include "../AsyncPlanner.h"
+#include "../ExpandableHashMap.h"
+#include "../ConcurrentHashMap.h"
+#include "../ServiceArea.h"
+#include "../PlanCache.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <list>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <random>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <future>
+#include <memory_resource>
+#include <mutex>
+#include <cstring>
+#include <cstdlib>
+#include <atomic>
+#include <new>
+#include <filesystem>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+using namespace std;
+
+//every allocation in the process is counted so plans can be compared by how much they allocate;
+//all of the plain, array and aligned forms are replaced together so each delete matches its new
+atomic<long long> g_allocations(0);
+
+void* countedAllocation(size_t size, size_t alignment)
+{
+	g_allocations.fetch_add(1, memory_order_relaxed);
+	if (size == 0)
+		size = 1;
+	void* p;
+	if (alignment <= alignof(max_align_t))
+		p = malloc(size);
+	else	//aligned_alloc wants a multiple of the alignment
+		p = aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+	if (p == nullptr)
+		throw bad_alloc();
+	return p;
+}
+
+void* operator new(size_t size) { return countedAllocation(size, 0); }
+void* operator new[](size_t size) { return countedAllocation(size, 0); }
+void* operator new(size_t size, align_val_t alignment) { return countedAllocation(size, (size_t)alignment); }
+void* operator new[](size_t size, align_val_t alignment) { return countedAllocation(size, (size_t)alignment); }
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+void operator delete(void* p, align_val_t) noexcept { free(p); }
+void operator delete[](void* p, align_val_t) noexcept { free(p); }
+void operator delete(void* p, size_t, align_val_t) noexcept { free(p); }
+void operator delete[](void* p, size_t, align_val_t) noexcept { free(p); }
+
+// L1 data cache and last level cache misses for this thread, read from the Linux
+// perf counters.  Where the counters can't be opened (other platforms, containers,
+// perf_event_paranoid) available() is false and only timings are reported.
+class CacheCounters
+{
+public:
+	CacheCounters()
+	{
+		m_l1 = openCounter(PERF_TYPE_HW_CACHE_ID, L1D_READ_MISS_CONFIG);
+		m_llc = openCounter(PERF_TYPE_HARDWARE_ID, LLC_MISS_CONFIG);
+	}
+	~CacheCounters()
+	{
+#ifdef __linux__
+		if (m_l1 != -1)
+			close(m_l1);
+		if (m_llc != -1)
+			close(m_llc);
+#endif
+	}
+	bool available() const { return m_l1 != -1 || m_llc != -1; }
+	void start()
+	{
+		control(m_l1, true);
+		control(m_llc, true);
+	}
+	void stop(long long& l1Misses, long long& llcMisses)
+	{
+		control(m_l1, false);
+		control(m_llc, false);
+		l1Misses = readCounter(m_l1);
+		llcMisses = readCounter(m_llc);
+	}
+	CacheCounters(const CacheCounters&) = delete;
+	CacheCounters& operator=(const CacheCounters&) = delete;
+private:
+#ifdef __linux__
+	static const unsigned int PERF_TYPE_HW_CACHE_ID = PERF_TYPE_HW_CACHE;
+	static const unsigned int PERF_TYPE_HARDWARE_ID = PERF_TYPE_HARDWARE;
+	static const unsigned long long L1D_READ_MISS_CONFIG = PERF_COUNT_HW_CACHE_L1D |
+		(PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+	static const unsigned long long LLC_MISS_CONFIG = PERF_COUNT_HW_CACHE_MISSES;
+#else
+	static const unsigned int PERF_TYPE_HW_CACHE_ID = 0;
+	static const unsigned int PERF_TYPE_HARDWARE_ID = 0;
+	static const unsigned long long L1D_READ_MISS_CONFIG = 0;
+	static const unsigned long long LLC_MISS_CONFIG = 0;
+#endif
+	int m_l1;
+	int m_llc;
+
+	static int openCounter(unsigned int type, unsigned long long config)
+	{
+#ifdef __linux__
+		perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = type;
+		attr.config = config;
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+		return -1;
+#endif
+	}
+	static void control(int fd, bool enable)
+	{
+#ifdef __linux__
+		if (fd == -1)
+			return;
+		if (enable)
+		{
+			ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+			ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+		}
+		else
+			ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+#endif
+	}
+	static long long readCounter(int fd)
+	{
+#ifdef __linux__
+		long long count = 0;
+		if (fd != -1 && read(fd, &count, sizeof(count)) == sizeof(count))
+			return count;
+#endif
+		return -1;
+	}
+};
+
+//random (start, end) pairs that are connected, so every query does a full search
+vector<pair<GeoCoord, GeoCoord>> randomQueries(const StreetGraph& graph, int numQueries, unsigned int seed)
+{
+	mt19937 generator(seed);
+	uniform_int_distribution<int> pickNode(0, graph.nodeCount() - 1);
+	vector<pair<GeoCoord, GeoCoord>> queries;
+	while (queries.size() < numQueries)
+	{
+		int start = pickNode(generator);
+		int end = pickNode(generator);
+		if (start != end && graph.component(start) == graph.component(end))
+			queries.push_back(make_pair(graph.coord(start), graph.coord(end)));
+	}
+	return queries;
+}
+
+double microsecondsSince(chrono::steady_clock::time_point start)
+{
+	return chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+}
+
+//run the same queries against the map loaded with each node order
+int benchmarkReorder(const string& mapFile, int numQueries)
+{
+	const NodeOrder orders[] = { LOAD_ORDER, HILBERT_ORDER, CUTHILL_MCKEE_ORDER };
+	const char* orderNames[] = { "load", "hilbert", "cuthill-mckee" };
+	vector<pair<GeoCoord, GeoCoord>> queries;
+	CacheCounters counters;
+	if (!counters.available())
+		cout << "perf counters unavailable, reporting latency only\n";
+
+	for (int i = 0; i < 3; i++)
+	{
+		StreetMap sm;
+		auto loadStart = chrono::steady_clock::now();
+		if (!sm.load(mapFile, orders[i]))
+		{
+			cout << "Unable to load map data file " << mapFile << endl;
+			return 1;
+		}
+		double loadMicros = microsecondsSince(loadStart);
+		if (queries.empty())
+			queries = randomQueries(*sm.getSnapshot()->graph, numQueries, 42);
+
+		PointToPointRouter router(&sm);
+		list<StreetSegment> route;
+		double distance = 0;
+		double totalDistance = 0;
+		long long l1Misses = 0;
+		long long llcMisses = 0;
+		auto queryStart = chrono::steady_clock::now();
+		counters.start();
+		for (int q = 0; q < queries.size(); q++)
+		{
+			router.generatePointToPointRoute(queries[q].first, queries[q].second, route, distance);
+			totalDistance += distance;
+		}
+		counters.stop(l1Misses, llcMisses);
+		double queryMicros = microsecondsSince(queryStart);
+
+		cout.setf(ios::fixed);
+		cout.precision(1);
+		cout << orderNames[i] << ": load " << loadMicros / 1000 << " ms, "
+			<< queryMicros / queries.size() << " us/query";
+		if (l1Misses >= 0)
+			cout << ", " << (double)l1Misses / queries.size() << " L1D misses/query";
+		if (llcMisses >= 0)
+			cout << ", " << (double)llcMisses / queries.size() << " LLC misses/query";
+		cout.precision(3);
+		cout << ", checksum " << totalDistance << " miles" << endl;
+	}
+	return 0;
+}
+
+//nodes expanded against route length as the weighted A* bound is loosened
+int benchmarkWeighted(const string& mapFile, int numQueries)
+{
+	StreetMap sm;
+	if (!sm.load(mapFile))
+	{
+		cout << "Unable to load map data file " << mapFile << endl;
+		return 1;
+	}
+	vector<pair<GeoCoord, GeoCoord>> queries = randomQueries(*sm.getSnapshot()->graph, numQueries, 42);
+	PointToPointRouter router(&sm);
+	const double weights[] = { 1, 1.1, 1.25, 1.5, 2, 3, 5 };
+	double exactDistance = 0;
+	long long exactExpanded = 0;
+
+	cout.setf(ios::fixed);
+	for (int w = 0; w < sizeof(weights) / sizeof(weights[0]); w++)
+	{
+		list<StreetSegment> route;
+		RouteSearchStats stats;
+		double distance = 0;
+		double totalDistance = 0;
+		long long expanded = 0;
+		double worstBound = 1;
+		double boundSum = 0;
+		auto start = chrono::steady_clock::now();
+		for (int q = 0; q < queries.size(); q++)
+		{
+			router.generatePointToPointRoute(queries[q].first, queries[q].second, weights[w], route, distance, stats);
+			totalDistance += distance;
+			expanded += stats.nodesExpanded;
+			worstBound = max(worstBound, stats.suboptimalityBound);
+			boundSum += stats.suboptimalityBound;
+		}
+		double micros = microsecondsSince(start);
+		if (w == 0)
+		{
+			exactDistance = totalDistance;
+			exactExpanded = expanded;
+		}
+
+		cout.precision(2);
+		cout << "w " << weights[w] << ": " << (double)expanded / queries.size() << " nodes expanded/query ("
+			<< 100.0 * expanded / exactExpanded << "%), route length " << 100.0 * totalDistance / exactDistance
+			<< "% of shortest, proven bound mean " << boundSum / queries.size() << " worst " << worstBound;
+		cout.precision(1);
+		cout << ", " << micros / queries.size() << " us/query" << endl;
+	}
+	return 0;
+}
+
+//legs to and from the first hub, searched with A* and then read off the hub trees
+int benchmarkHubs(const string& mapFile, const string& hubFile, int numQueries)
+{
+	StreetMap sm;
+	if (!sm.load(mapFile))
+	{
+		cout << "Unable to load map data file " << mapFile << endl;
+		return 1;
+	}
+	shared_ptr<const MapSnapshot> plain = sm.getSnapshot();
+	if (!sm.loadHubs(hubFile))
+	{
+		cout << "Unable to load hub file " << hubFile << endl;
+		return 1;
+	}
+	shared_ptr<const MapSnapshot> withHubs = sm.getSnapshot();
+	const StreetGraph& graph = *withHubs->graph;
+	if (withHubs->hubs->hubCount() == 0)
+	{
+		cout << "No hubs in " << hubFile << endl;
+		return 1;
+	}
+	int hub = withHubs->hubs->hubNode(0);
+
+	vector<pair<int, int>> legs;
+	mt19937 generator(42);
+	uniform_int_distribution<int> pickNode(0, graph.nodeCount() - 1);
+	while (legs.size() < numQueries)
+	{
+		int node = pickNode(generator);
+		if (node != hub && graph.component(node) == graph.component(hub))
+			legs.push_back(legs.size() % 2 == 0 ? make_pair(hub, node) : make_pair(node, hub));
+	}
+
+	const char* names[] = { "A*", "hub trees" };
+	const MapSnapshot* maps[] = { plain.get(), withHubs.get() };
+	cout.setf(ios::fixed);
+	for (int i = 0; i < 2; i++)
+	{
+		pmr::monotonic_buffer_resource arena;
+		RouteScratch scratch(graph, &arena);
+		EdgeRoute edges(&arena);
+		double distance = 0;
+		double totalDistance = 0;
+		auto start = chrono::steady_clock::now();
+		for (int q = 0; q < legs.size(); q++)
+		{
+			searchRoute(*maps[i], legs[q].first, legs[q].second, edges, distance, scratch);
+			totalDistance += distance;
+		}
+		double micros = microsecondsSince(start);
+		cout.precision(2);
+		cout << names[i] << ": " << micros / legs.size() << " us/leg";
+		cout.precision(4);
+		cout << ", checksum " << totalDistance << " miles" << endl;
+	}
+	return 0;
+}
+
+//startup time and tiles touched by routing over a tiled map, against the whole map in memory
+int benchmarkTiles(const string& mapFile, const string& tileFile, int numQueries, int maxResidentTiles)
+{
+	StreetMap sm;
+	auto loadStart = chrono::steady_clock::now();
+	if (!sm.load(mapFile))
+	{
+		cout << "Unable to load map data file " << mapFile << endl;
+		return 1;
+	}
+	double loadMicros = microsecondsSince(loadStart);
+	TiledMap tiles;
+	auto openStart = chrono::steady_clock::now();
+	if (!tiles.open(tileFile, maxResidentTiles))
+	{
+		cout << "Unable to open tile file " << tileFile << endl;
+		return 1;
+	}
+	double openMicros = microsecondsSince(openStart);
+	cout.setf(ios::fixed);
+	cout.precision(2);
+	cout << "startup: load " << loadMicros / 1000 << " ms, open tiles " << openMicros / 1000 << " ms ("
+		<< tiles.tileCount() << " tiles, at most " << maxResidentTiles << " resident)" << endl;
+
+	//the same number of queries across the whole map and between nodes close together
+	//on the Hilbert curve, which stay within a neighbourhood
+	const StreetGraph& graph = *sm.getSnapshot()->graph;
+	vector<pair<GeoCoord, GeoCoord>> spread = randomQueries(graph, numQueries, 42);
+	vector<pair<GeoCoord, GeoCoord>> local;
+	mt19937 generator(42);
+	uniform_int_distribution<int> pickNode(0, graph.nodeCount() - 1);
+	uniform_int_distribution<int> pickOffset(-200, 200);
+	while (local.size() < numQueries)
+	{
+		int start = pickNode(generator);
+		int end = start + pickOffset(generator);
+		if (end >= 0 && end < graph.nodeCount() && end != start && graph.component(start) == graph.component(end))
+			local.push_back(make_pair(graph.coord(start), graph.coord(end)));
+	}
+
+	const char* setNames[] = { "spread", "local" };
+	vector<pair<GeoCoord, GeoCoord>>* sets[] = { &spread, &local };
+	PointToPointRouter inMemory(&sm);
+	PointToPointRouter tiled(&tiles);
+	for (int s = 0; s < 2; s++)
+	{
+		const vector<pair<GeoCoord, GeoCoord>>& queries = *sets[s];
+		list<StreetSegment> route;
+		double distance = 0;
+		double memoryDistance = 0;
+		auto memoryStart = chrono::steady_clock::now();
+		for (int q = 0; q < queries.size(); q++)
+		{
+			inMemory.generatePointToPointRoute(queries[q].first, queries[q].second, route, distance);
+			memoryDistance += distance;
+		}
+		double memoryMicros = microsecondsSince(memoryStart);
+
+		double tiledDistance = 0;
+		int readsBefore = tiles.tilesRead();
+		auto tiledStart = chrono::steady_clock::now();
+		for (int q = 0; q < queries.size(); q++)
+		{
+			tiled.generatePointToPointRoute(queries[q].first, queries[q].second, route, distance);
+			tiledDistance += distance;
+		}
+		double tiledMicros = microsecondsSince(tiledStart);
+
+		cout.precision(1);
+		cout << setNames[s] << ": in memory " << memoryMicros / queries.size() << " us/query, tiled "
+			<< tiledMicros / queries.size() << " us/query, ";
+		cout.precision(2);
+		cout << (double)(tiles.tilesRead() - readsBefore) / queries.size() << " tile reads/query";
+		cout.precision(3);
+		cout << ", checksums " << memoryDistance << " / " << tiledDistance << " miles" << endl;
+	}
+	return 0;
+}
+
+//random stops reachable from the first node of the largest component, which serves as the depot
+void randomManifest(const StreetGraph& graph, int numStops, unsigned int seed, GeoCoord& depot, vector<DeliveryRequest>& deliveries)
+{
+	vector<int> componentSizes;
+	for (int i = 0; i < graph.nodeCount(); i++)
+	{
+		if (graph.component(i) >= componentSizes.size())
+			componentSizes.resize(graph.component(i) + 1, 0);
+		componentSizes[graph.component(i)]++;
+	}
+	int largest = max_element(componentSizes.begin(), componentSizes.end()) - componentSizes.begin();
+	vector<int> nodes;
+	for (int i = 0; i < graph.nodeCount(); i++)
+		if (graph.component(i) == largest)
+			nodes.push_back(i);
+
+	mt19937 generator(seed);
+	uniform_int_distribution<int> pickNode(0, nodes.size() - 1);
+	depot = graph.coord(nodes[0]);
+	deliveries.clear();
+	for (int i = 0; i < numStops; i++)
+		deliveries.push_back(DeliveryRequest("item " + to_string(i), graph.coord(nodes[pickNode(generator)])));
+}
+
+class CountingSink : public DeliveryCommandSink
+{
+public:
+	CountingSink() : commands(0) {}
+	void receive(const DeliveryCommand&) { commands++; }
+	long long commands;
+};
+
+//allocations and time for whole delivery plans
+int benchmarkAllocations(const string& mapFile, int numStops, int numPlans)
+{
+	StreetMap sm;
+	if (!sm.load(mapFile))
+	{
+		cout << "Unable to load map data file " << mapFile << endl;
+		return 1;
+	}
+	GeoCoord depot;
+	vector<DeliveryRequest> deliveries;
+	randomManifest(*sm.getSnapshot()->graph, numStops, 7, depot, deliveries);
+
+	DeliveryPlanner planner(&sm);
+	vector<DeliveryCommand> commands;
+	double miles = 0;
+	long long before = g_allocations.load();
+	auto start = chrono::steady_clock::now();
+	for (int i = 0; i < numPlans; i++)
+		planner.generateDeliveryPlan(depot, deliveries, commands, miles);
+	double micros = microsecondsSince(start);
+	long long allocations = g_allocations.load() - before;
+
+	//the same plans streamed to a sink that only counts, so nothing holds the whole plan
+	CountingSink counter;
+	before = g_allocations.load();
+	start = chrono::steady_clock::now();
+	for (int i = 0; i < numPlans; i++)
+		planner.generateDeliveryPlan(depot, deliveries, counter, miles);
+	double streamedMicros = microsecondsSince(start);
+	long long streamedAllocations = g_allocations.load() - before;
+
+	cout.setf(ios::fixed);
+	cout.precision(1);
+	cout << numStops << " stops: " << (double)allocations / numPlans << " allocations/plan, "
+		<< micros / numPlans / 1000 << " ms/plan, " << commands.size() << " commands" << endl;
+	cout << numStops << " stops streamed: " << (double)streamedAllocations / numPlans << " allocations/plan, "
+		<< streamedMicros / numPlans / 1000 << " ms/plan, " << counter.commands / numPlans << " commands" << endl;
+	return 0;
+}
+
+//straight line length of the tour from the depot through every stop and back
+double crowTourMiles(const GeoCoord& depot, const vector<DeliveryRequest>& deliveries)
+{
+	double miles = 0;
+	GeoCoord previous = depot;
+	for (int i = 0; i < deliveries.size(); i++)
+	{
+		miles += distanceEarthMiles(previous, deliveries[i].location);
+		previous = deliveries[i].location;
+	}
+	return miles + distanceEarthMiles(previous, depot);
+}
+
+//time and tour length of optimizing one big manifest
+int benchmarkOptimizer(const string& mapFile, int numStops)
+{
+	StreetMap sm;
+	if (!sm.load(mapFile))
+	{
+		cout << "Unable to load map data file " << mapFile << endl;
+		return 1;
+	}
+	GeoCoord depot;
+	vector<DeliveryRequest> deliveries;
+	randomManifest(*sm.getSnapshot()->graph, numStops, 7, depot, deliveries);
+
+	DeliveryOptimizer optimizer(&sm);
+	double oldCrowDistance = 0;
+	double newCrowDistance = 0;
+	double before = crowTourMiles(depot, deliveries);
+	auto start = chrono::steady_clock::now();
+	optimizer.optimizeDeliveryOrder(depot, deliveries, oldCrowDistance, newCrowDistance);
+	double micros = microsecondsSince(start);
+	double after = crowTourMiles(depot, deliveries);
+
+	cout.setf(ios::fixed);
+	cout.precision(1);
+	cout << numStops << " stops: " << before << " -> " << after << " crow miles in "
+		<< micros / 1000 << " ms" << endl;
+	return 0;
+}
+
+//many manifests from one depot over a shared pool of addresses, planned one at a time and as a batch
+int benchmarkBatch(const string& mapFile, int numJobs, int numStops)
+{
+	StreetMap sm;
+	if (!sm.load(mapFile))
+	{
+		cout << "Unable to load map data file " << mapFile << endl;
+		return 1;
+	}
+	GeoCoord depot;
+	vector<DeliveryRequest> addresses;
+	randomManifest(*sm.getSnapshot()->graph, 4 * numStops, 7, depot, addresses);
+	mt19937 generator(11);
+	vector<BatchJob> jobs(numJobs);
+	for (int j = 0; j < numJobs; j++)
+	{
+		jobs[j].depot = depot;
+		vector<DeliveryRequest> pool = addresses;
+		shuffle(pool.begin(), pool.end(), generator);
+		jobs[j].deliveries.assign(pool.begin(), pool.begin() + numStops);
+	}
+
+	DeliveryPlanner planner(&sm);
+	vector<DeliveryCommand> commands;
+	double miles = 0;
+	double sequentialMiles = 0;
+	auto start = chrono::steady_clock::now();
+	for (int j = 0; j < numJobs; j++)
+	{
+		planner.generateDeliveryPlan(jobs[j].depot, jobs[j].deliveries, commands, miles);
+		sequentialMiles += miles;
+	}
+	double sequentialMicros = microsecondsSince(start);
+
+	BatchPlanner batch(&sm);
+	vector<BatchJobResult> results;
+	start = chrono::steady_clock::now();
+	batch.generateDeliveryPlans(jobs, results);
+	double batchMicros = microsecondsSince(start);
+	double batchMiles = 0;
+	int failed = 0;
+	for (int j = 0; j < results.size(); j++)
+	{
+		batchMiles += results[j].totalDistanceTravelled;
+		if (results[j].status != DELIVERY_SUCCESS)
+			failed++;
+	}
+
+	cout.setf(ios::fixed);
+	cout.precision(1);
+	cout << numJobs << " jobs of " << numStops << " stops from " << addresses.size() << " addresses" << endl;
+	cout << "one at a time: " << sequentialMicros / 1000 << " ms, " << sequentialMiles << " miles" << endl;
+	cout << "batch:         " << batchMicros / 1000 << " ms, " << batchMiles << " miles, " << failed << " failed" << endl;
+	return 0;
+}
+
+//a big generated manifest read line by line with getline and istringstream, and with ManifestReader
+int benchmarkManifest(const string& mapFile, int numLines)
+{
+	StreetMap sm;
+	if (!sm.load(mapFile))
+	{
+		cout << "Unable to load map data file " << mapFile << endl;
+		return 1;
+	}
+	GeoCoord depot;
+	vector<DeliveryRequest> deliveries;
+	randomManifest(*sm.getSnapshot()->graph, numLines, 7, depot, deliveries);
+	string manifestFile = "benchmark_manifest.tmp";
+	{
+		ofstream outf(manifestFile);
+		outf << depot.latitudeText << " " << depot.longitudeText << "\n";
+		for (int i = 0; i < deliveries.size(); i++)
+			outf << deliveries[i].location.latitudeText << " " << deliveries[i].location.longitudeText << ":" << deliveries[i].item << "\n";
+	}
+
+	auto start = chrono::steady_clock::now();
+	vector<DeliveryRequest> byLine;
+	{
+		ifstream inf(manifestFile);
+		string lat;
+		string lon;
+		inf >> lat >> lon;
+		inf.ignore(10000, '\n');
+		string line;
+		while (getline(inf, line))
+		{
+			size_t colon = line.find(':');
+			istringstream iss(line.substr(0, colon));
+			if (colon != string::npos && iss >> lat >> lon)
+				byLine.push_back(DeliveryRequest(line.substr(colon + 1), GeoCoord(lat, lon)));
+		}
+	}
+	double lineMicros = microsecondsSince(start);
+
+	ManifestReader reader;
+	start = chrono::steady_clock::now();
+	reader.read(manifestFile, 1);
+	double readerMicros = microsecondsSince(start);
+	start = chrono::steady_clock::now();
+	reader.read(manifestFile, 0);
+	double parallelMicros = microsecondsSince(start);
+	remove(manifestFile.c_str());
+
+	cout.setf(ios::fixed);
+	cout.precision(1);
+	cout << numLines << " lines" << endl;
+	cout << "getline:             " << lineMicros / 1000 << " ms, " << byLine.size() << " deliveries" << endl;
+	cout << "mapped, one thread:  " << readerMicros / 1000 << " ms" << endl;
+	cout << "mapped, every core:  " << parallelMicros / 1000 << " ms, " << reader.deliveries().size() << " deliveries, "
+		<< reader.errors().size() << " errors" << endl;
+	return 0;
+}
+
+//how long cancelled plans keep their workers busy: plans are started in the background,
+//all cancelled after a short while, and timed until every future has an answer
+int benchmarkCancel(const string& mapFile, int numPlans, int numStops)
+{
+	StreetMap sm;
+	if (!sm.load(mapFile))
+	{
+		cout << "Unable to load map data file " << mapFile << endl;
+		return 1;
+	}
+	GeoCoord depot;
+	vector<DeliveryRequest> deliveries;
+	randomManifest(*sm.getSnapshot()->graph, numStops, 7, depot, deliveries);
+
+	AsyncPlanner planner(&sm);
+	auto start = chrono::steady_clock::now();
+	planner.generateDeliveryPlan(depot, deliveries).get();
+	double fullMicros = microsecondsSince(start);
+
+	CancellationToken cancel;
+	vector<future<PlanOutcome>> outcomes;
+	for (int i = 0; i < numPlans; i++)
+		outcomes.push_back(planner.generateDeliveryPlan(depot, deliveries, cancel));
+	this_thread::sleep_for(chrono::microseconds((long long)(fullMicros / 4)));
+	start = chrono::steady_clock::now();
+	cancel.cancel();
+	int cancelled = 0;
+	for (int i = 0; i < outcomes.size(); i++)
+		if (outcomes[i].get().result == CANCELLED)
+			cancelled++;
+	double drainMicros = microsecondsSince(start);
+
+	cout.setf(ios::fixed);
+	cout.precision(1);
+	cout << "one plan of " << numStops << " stops: " << fullMicros / 1000 << " ms" << endl;
+	cout << numPlans << " plans cancelled: " << cancelled << " reported CANCELLED, all answered "
+		<< drainMicros / 1000 << " ms after cancelling" << endl;
+	return 0;
+}
+
+unsigned int hasher(const int& k)
+{
+	return (unsigned int)k * 2654435761u;
+}
+
+//threads hammering one shared table with a mix of lookups and inserts, first an
+//ExpandableHashMap behind one mutex and then a ConcurrentHashMap
+int benchmarkHashMap(int maxThreads, int opsPerThread)
+{
+	const int KEY_RANGE = 1 << 20;
+	const int WRITE_PERCENT = 10;
+	cout.setf(ios::fixed);
+	cout.precision(1);
+	cout << opsPerThread << " operations per thread, " << WRITE_PERCENT << "% inserts" << endl;
+	for (int numThreads = 1; numThreads <= maxThreads; numThreads *= 2)
+	{
+		//each thread runs the same script of operations against whichever map run is given
+		auto timeRun = [&](const function<void(bool, int)>& operation)
+		{
+			auto start = chrono::steady_clock::now();
+			vector<thread> threads;
+			for (int t = 0; t < numThreads; t++)
+			{
+				threads.push_back(thread([&, t]()
+				{
+					mt19937 generator(t + 1);
+					uniform_int_distribution<int> pickKey(0, KEY_RANGE - 1);
+					uniform_int_distribution<int> pickPercent(0, 99);
+					for (int i = 0; i < opsPerThread; i++)
+						operation(pickPercent(generator) < WRITE_PERCENT, pickKey(generator));
+				}));
+			}
+			for (int t = 0; t < numThreads; t++)
+				threads[t].join();
+			return microsecondsSince(start);
+		};
+
+		ExpandableHashMap<int, int> locked;
+		mutex lockedMutex;
+		double lockedMicros = timeRun([&](bool write, int key)
+		{
+			lock_guard<mutex> lock(lockedMutex);
+			if (write)
+				locked.associate(key, key);
+			else
+				locked.find(key);
+		});
+		ConcurrentHashMap<int, int> concurrent;
+		double concurrentMicros = timeRun([&](bool write, int key)
+		{
+			int value = 0;
+			if (write)
+				concurrent.associate(key, key);
+			else
+				concurrent.find(key, value);
+		});
+
+		double ops = (double)numThreads * opsPerThread;
+		cout << numThreads << " threads: locked ExpandableHashMap " << ops / lockedMicros << " Mops/s, ConcurrentHashMap "
+			<< ops / concurrentMicros << " Mops/s (" << locked.size() << " / " << concurrent.size() << " keys)" << endl;
+	}
+	return 0;
+}
+
+//memory per edge and query time of a compressed graph, against the StreetGraph it was built from
+int benchmarkCompressed(const string& mapFile, int numQueries)
+{
+	StreetMap sm;
+	if (!sm.load(mapFile))
+	{
+		cout << "Unable to load map data file " << mapFile << endl;
+		return 1;
+	}
+	const StreetGraph& graph = *sm.getSnapshot()->graph;
+	CompressedGraph compressed;
+	auto buildStart = chrono::steady_clock::now();
+	if (!compressed.build(graph))
+	{
+		cout << "Coords in " << mapFile << " are too precise to compress" << endl;
+		return 1;
+	}
+	double buildMicros = microsecondsSince(buildStart);
+	cout.setf(ios::fixed);
+	cout.precision(1);
+	int edges = max(1, graph.edgeCount());
+	cout << graph.nodeCount() << " nodes, " << graph.edgeCount() << " edges, compressed in " << buildMicros / 1000 << " ms" << endl;
+	cout << "memory: StreetGraph " << graph.bytes() / 1024 << " KiB (" << (double)graph.bytes() / edges << " bytes/edge), "
+		<< "compressed " << compressed.bytes() / 1024 << " KiB (" << (double)compressed.bytes() / edges << " bytes/edge)" << endl;
+
+	vector<pair<GeoCoord, GeoCoord>> queries = randomQueries(graph, numQueries, 42);
+	PointToPointRouter plain(&sm);
+	PointToPointRouter packed(&compressed);
+	vector<double> plainDistances(queries.size());
+	vector<double> packedDistances(queries.size());
+	list<StreetSegment> route;
+	//each router runs twice and keeps its faster time, so neither pays for warming the caches
+	double plainMicros = HUGE_VAL;
+	double packedMicros = HUGE_VAL;
+	for (int round = 0; round < 2; round++)
+	{
+		auto plainStart = chrono::steady_clock::now();
+		for (int q = 0; q < queries.size(); q++)
+			plain.generatePointToPointRoute(queries[q].first, queries[q].second, route, plainDistances[q]);
+		plainMicros = min(plainMicros, microsecondsSince(plainStart));
+		auto packedStart = chrono::steady_clock::now();
+		for (int q = 0; q < queries.size(); q++)
+			packed.generatePointToPointRoute(queries[q].first, queries[q].second, route, packedDistances[q]);
+		packedMicros = min(packedMicros, microsecondsSince(packedStart));
+	}
+
+	//rounded lengths can pick a different one of two nearly equal routes
+	int differing = 0;
+	double largestDifference = 0;
+	for (int q = 0; q < queries.size(); q++)
+	{
+		double difference = fabs(packedDistances[q] - plainDistances[q]) / max(plainDistances[q], 1e-9);
+		if (difference > 1e-9)
+			differing++;
+		largestDifference = max(largestDifference, difference);
+	}
+	cout << "queries: StreetGraph " << plainMicros / queries.size() << " us/query, compressed " << packedMicros / queries.size()
+		<< " us/query (" << packedMicros / plainMicros << "x)" << endl;
+	cout.precision(4);
+	cout << differing << " of " << queries.size() << " routes differ in length, largest by " << 100 * largestDifference << "%" << endl;
+	return 0;
+}
+
+//"which of these addresses are within so many miles of the depot?" answered by routing to
+//each address and by one bounded search, then whole service areas for many depots at once
+int benchmarkServiceArea(const string& mapFile, int numDepots, double maxMiles)
+{
+	StreetMap sm;
+	if (!sm.load(mapFile))
+	{
+		cout << "Unable to load map data file " << mapFile << endl;
+		return 1;
+	}
+	const StreetGraph& graph = *sm.getSnapshot()->graph;
+	GeoCoord depot;
+	vector<DeliveryRequest> requests;
+	randomManifest(graph, 1000, 11, depot, requests);
+	vector<GeoCoord> addresses;
+	for (int i = 0; i < requests.size(); i++)
+		addresses.push_back(requests[i].location);
+
+	PointToPointRouter router(&sm);
+	auto routedStart = chrono::steady_clock::now();
+	vector<bool> routedWithin(addresses.size());
+	list<StreetSegment> route;
+	for (int i = 0; i < addresses.size(); i++)
+	{
+		double distance = 0;
+		routedWithin[i] = router.generatePointToPointRoute(depot, addresses[i], route, distance) == DELIVERY_SUCCESS
+			&& distance <= maxMiles;
+	}
+	double routedMicros = microsecondsSince(routedStart);
+	ServiceArea areas(&sm);
+	vector<bool> within;
+	auto searchedStart = chrono::steady_clock::now();
+	areas.testAddresses(depot, maxMiles, addresses, within);
+	double searchedMicros = microsecondsSince(searchedStart);
+	int inside = count(within.begin(), within.end(), true);
+	int disagreements = 0;
+	for (int i = 0; i < addresses.size(); i++)
+		if (within[i] != routedWithin[i])
+			disagreements++;
+	cout.setf(ios::fixed);
+	cout.precision(1);
+	cout << addresses.size() << " addresses, " << inside << " within " << maxMiles << " miles: routing to each "
+		<< routedMicros / 1000 << " ms, one bounded search " << searchedMicros / 1000 << " ms, "
+		<< disagreements << " disagreements" << endl;
+
+	vector<GeoCoord> depots;
+	mt19937 generator(3);
+	uniform_int_distribution<int> pickNode(0, graph.nodeCount() - 1);
+	for (int d = 0; d < numDepots; d++)
+		depots.push_back(graph.coord(pickNode(generator)));
+	vector<ServiceAreaResult> results;
+	for (int workers = 1; workers <= max(1u, thread::hardware_concurrency()); workers *= 2)
+	{
+		ServiceArea pool(&sm, workers);
+		auto start = chrono::steady_clock::now();
+		pool.findServiceAreas(depots, maxMiles, true, results);
+		double micros = microsecondsSince(start);
+		long long nodes = 0;
+		long long corners = 0;
+		for (int d = 0; d < results.size(); d++)
+		{
+			nodes += results[d].reachable.size();
+			corners += results[d].boundary.size();
+		}
+		cout << numDepots << " service areas with boundaries on " << workers << " threads: " << micros / 1000 << " ms, "
+			<< (double)nodes / max(1, numDepots) << " nodes and " << (double)corners / max(1, numDepots) << " boundary points each" << endl;
+	}
+	return 0;
+}
+
+//planning the same manifests again without a cache, from the cache in memory, and from the
+//cache's files as a restarted process would
+int benchmarkPlanCache(const string& mapFile, int numPlans, int numStops)
+{
+	StreetMap sm;
+	if (!sm.load(mapFile))
+	{
+		cout << "Unable to load map data file " << mapFile << endl;
+		return 1;
+	}
+	const StreetGraph& graph = *sm.getSnapshot()->graph;
+	vector<GeoCoord> depots(numPlans);
+	vector<vector<DeliveryRequest>> manifests(numPlans);
+	for (int p = 0; p < numPlans; p++)
+		randomManifest(graph, numStops, p + 1, depots[p], manifests[p]);
+	string directory = "plancache_benchmark";
+	error_code error;
+	filesystem::remove_all(directory, error);
+
+	vector<DeliveryCommand> commands;
+	double distance = 0;
+	auto timePlans = [&](const DeliveryPlanner& planner)
+	{
+		auto start = chrono::steady_clock::now();
+		for (int p = 0; p < numPlans; p++)
+			planner.generateDeliveryPlan(depots[p], manifests[p], commands, distance);
+		return microsecondsSince(start) / max(1, numPlans);
+	};
+	double uncachedMicros = timePlans(DeliveryPlanner(&sm));
+	PlanCache cache;
+	if (!cache.openDirectory(directory))
+	{
+		cout << "Unable to use plan cache directory " << directory << endl;
+		return 1;
+	}
+	DeliveryPlanner cached(&sm, &cache);
+	double firstMicros = timePlans(cached);
+	double memoryMicros = timePlans(cached);
+	PlanCache restarted;
+	restarted.openDirectory(directory);
+	double diskMicros = timePlans(DeliveryPlanner(&sm, &restarted));
+	filesystem::remove_all(directory, error);
+	//roughly what keeping the command lists themselves would take
+	size_t commandBytes = 0;
+	for (int p = 0; p < numPlans; p++)
+	{
+		cached.generateDeliveryPlan(depots[p], manifests[p], commands, distance);
+		for (int c = 0; c < commands.size(); c++)
+			commandBytes += sizeof(DeliveryCommand) + commands[c].description().size();
+	}
+
+	cout.setf(ios::fixed);
+	cout.precision(1);
+	cout << numPlans << " plans of " << numStops << " stops: no cache " << uncachedMicros << " us/plan, first time cached "
+		<< firstMicros << " us/plan, from memory " << memoryMicros << " us/plan, from disk " << diskMicros << " us/plan" << endl;
+	cout << "memory: " << (double)cache.bytes() / max(1, numPlans) << " bytes/plan cached, about "
+		<< (double)commandBytes / max(1, numPlans) << " bytes/plan as command lists" << endl;
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc >= 3 && strcmp(argv[1], "reorder") == 0)
+		return benchmarkReorder(argv[2], argc >= 4 ? atoi(argv[3]) : 2000);
+	if (argc >= 3 && strcmp(argv[1], "alloc") == 0)
+		return benchmarkAllocations(argv[2], argc >= 4 ? atoi(argv[3]) : 25, argc >= 5 ? atoi(argv[4]) : 20);
+	if (argc >= 3 && strcmp(argv[1], "weighted") == 0)
+		return benchmarkWeighted(argv[2], argc >= 4 ? atoi(argv[3]) : 2000);
+	if (argc >= 4 && strcmp(argv[1], "hubs") == 0)
+		return benchmarkHubs(argv[2], argv[3], argc >= 5 ? atoi(argv[4]) : 2000);
+	if (argc >= 4 && strcmp(argv[1], "tiles") == 0)
+		return benchmarkTiles(argv[2], argv[3], argc >= 5 ? atoi(argv[4]) : 1000, argc >= 6 ? atoi(argv[5]) : 4);
+	if (argc >= 3 && strcmp(argv[1], "optimize") == 0)
+		return benchmarkOptimizer(argv[2], argc >= 4 ? atoi(argv[3]) : 2000);
+	if (argc >= 3 && strcmp(argv[1], "batch") == 0)
+		return benchmarkBatch(argv[2], argc >= 4 ? atoi(argv[3]) : 200, argc >= 5 ? atoi(argv[4]) : 15);
+	if (argc >= 3 && strcmp(argv[1], "manifest") == 0)
+		return benchmarkManifest(argv[2], argc >= 4 ? atoi(argv[3]) : 500000);
+	if (argc >= 2 && strcmp(argv[1], "hashmap") == 0)
+		return benchmarkHashMap(argc >= 3 ? atoi(argv[2]) : max(1u, thread::hardware_concurrency()), argc >= 4 ? atoi(argv[3]) : 1000000);
+	if (argc >= 3 && strcmp(argv[1], "cancel") == 0)
+		return benchmarkCancel(argv[2], argc >= 4 ? atoi(argv[3]) : 50, argc >= 5 ? atoi(argv[4]) : 100);
+	if (argc >= 3 && strcmp(argv[1], "compressed") == 0)
+		return benchmarkCompressed(argv[2], argc >= 4 ? atoi(argv[3]) : 2000);
+	if (argc >= 3 && strcmp(argv[1], "servicearea") == 0)
+		return benchmarkServiceArea(argv[2], argc >= 4 ? atoi(argv[3]) : 100, argc >= 5 ? atof(argv[4]) : 2);
+	if (argc >= 3 && strcmp(argv[1], "plancache") == 0)
+		return benchmarkPlanCache(argv[2], argc >= 4 ? atoi(argv[3]) : 50, argc >= 5 ? atoi(argv[4]) : 25);
+
+	cout << "Usage: " << argv[0] << " reorder mapdata.txt [queries]" << endl;
+	cout << "       " << argv[0] << " alloc mapdata.txt [stops] [plans]" << endl;
+	cout << "       " << argv[0] << " weighted mapdata.txt [queries]" << endl;
+	cout << "       " << argv[0] << " hubs mapdata.txt hubs.bin [queries]" << endl;
+	cout << "       " << argv[0] << " tiles mapdata.txt tiles.bin [queries] [residentTiles]" << endl;
+	cout << "       " << argv[0] << " optimize mapdata.txt [stops]" << endl;
+	cout << "       " << argv[0] << " batch mapdata.txt [jobs] [stops]" << endl;
+	cout << "       " << argv[0] << " manifest mapdata.txt [lines]" << endl;
+	cout << "       " << argv[0] << " cancel mapdata.txt [plans] [stops]" << endl;
+	cout << "       " << argv[0] << " hashmap [threads] [operations]" << endl;
+	cout << "       " << argv[0] << " compressed mapdata.txt [queries]" << endl;
+	cout << "       " << argv[0] << " servicearea mapdata.txt [depots] [miles]" << endl;
+	cout << "       " << argv[0] << " plancache mapdata.txt [plans] [stops]" << endl;
+	return 1;
+}
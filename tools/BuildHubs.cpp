@@ -0,0 +1,78 @@
+// BuildHubs.cpp
+
+// Precomputes the shortest path trees from each hub for StreetMap::loadHubs.  Build from
+// the repository root with
+//     g++ -std=c++17 -O2 -pthread -o buildhubs tools/BuildHubs.cpp $(ls *.cpp | grep -v main.cpp)
+// and run
+//     buildhubs mapdata.txt hubs.txt hubs.bin
+// where hubs.txt holds one "latitude longitude" line per hub.  The file is only good for
+// the map file it was built from.
+
+#include "../provided.h"
+#include "../MapSnapshot.h"
+#include "../HubOracle.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+using namespace std;
+
+int main(int argc, char *argv[])
+{
+	if (argc != 4)
+	{
+		cout << "Usage: " << argv[0] << " mapdata.txt hubs.txt hubs.bin" << endl;
+		return 1;
+	}
+
+	StreetMap sm;
+	if (!sm.load(argv[1]))
+	{
+		cout << "Unable to load map data file " << argv[1] << endl;
+		return 1;
+	}
+	const StreetGraph& graph = *sm.getSnapshot()->graph;
+
+	ifstream inf(argv[2]);
+	if (!inf)
+	{
+		cout << "Unable to load hub file " << argv[2] << endl;
+		return 1;
+	}
+	vector<GeoCoord> hubs;
+	string line;
+	while (getline(inf, line))
+	{
+		istringstream iss(line);
+		string lat;
+		string lon;
+		if (!(iss >> lat >> lon))
+			continue;
+		GeoCoord hub(lat, lon);
+		if (graph.findNode(hub) == -1)
+		{
+			cout << "Hub is not on the map: " << line << endl;
+			return 1;
+		}
+		hubs.push_back(hub);
+	}
+
+	HubOracle oracle;
+	auto start = chrono::steady_clock::now();
+	if (!oracle.build(graph, hubs))
+	{
+		cout << "Unable to build hub trees" << endl;
+		return 1;
+	}
+	double millis = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+	if (!oracle.save(argv[3]))
+	{
+		cout << "Unable to write " << argv[3] << endl;
+		return 1;
+	}
+	cout << hubs.size() << " hubs over " << graph.nodeCount() << " nodes in " << millis << " ms, "
+		<< hubs.size() * graph.nodeCount() * 5 << " bytes of trees" << endl;
+	return 0;
+}
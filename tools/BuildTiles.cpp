@@ -0,0 +1,47 @@
+// BuildTiles.cpp
+
+// Writes a map data file in the tiled format that TiledMap reads on demand.  Build from
+// the repository root with
+//     g++ -std=c++17 -O2 -pthread -o buildtiles tools/BuildTiles.cpp $(ls *.cpp | grep -v main.cpp)
+// and run
+//     buildtiles mapdata.txt tiles.bin [nodesPerTile]
+
+#include "../provided.h"
+#include "../MapSnapshot.h"
+#include "../TiledMap.h"
+#include <iostream>
+#include <string>
+#include <cstdlib>
+using namespace std;
+
+int main(int argc, char *argv[])
+{
+	if (argc != 3 && argc != 4)
+	{
+		cout << "Usage: " << argv[0] << " mapdata.txt tiles.bin [nodesPerTile]" << endl;
+		return 1;
+	}
+	int nodesPerTile = argc == 4 ? atoi(argv[3]) : 1024;
+
+	StreetMap sm;
+	if (!sm.load(argv[1], HILBERT_ORDER))
+	{
+		cout << "Unable to load map data file " << argv[1] << endl;
+		return 1;
+	}
+	const StreetGraph& graph = *sm.getSnapshot()->graph;
+	if (!TiledMap::write(graph, nodesPerTile, argv[2]))
+	{
+		cout << "Unable to write " << argv[2] << endl;
+		return 1;
+	}
+
+	TiledMap tiles;
+	if (!tiles.open(argv[2], 1))
+	{
+		cout << "Unable to read back " << argv[2] << endl;
+		return 1;
+	}
+	cout << graph.nodeCount() << " nodes in " << tiles.tileCount() << " tiles" << endl;
+	return 0;
+}
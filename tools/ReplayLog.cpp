@@ -0,0 +1,270 @@
+// ReplayLog.cpp
+
+// Replays a query log (see QueryLog.h) against a map to reproduce a recorded workload.
+// Every logged route and plan is issued again, on several threads, either as fast as
+// they will go or at the pace they originally arrived.  Reports throughput, latency
+// percentiles beside the ones recorded, and every call whose result differs from the
+// logged one.
+//
+// Build from the repository root with
+//     g++ -std=c++17 -O2 -pthread -o replaylog tools/ReplayLog.cpp $(ls *.cpp | grep -v main.cpp)
+// and run
+//     replaylog mapdata.txt queries.log [threads] [paced]     replay a log
+//     replaylog record mapdata.txt queries.log [routes] [plans]  record random calls
+//
+// A log is written by "--serve mapdata.txt workers queries.log", by any program that
+// makes a QueryLog active, or by the record command, which also reports what recording
+// costs each call.
+//
+// Paced latencies are measured from when a call was due rather than when it started, so
+// a replay that falls behind shows the wait in its percentiles.  Plans are ordered by
+// annealing, which is random, so plan distances are expected to drift a little; only
+// result codes and route distances count as differences.
+
+#include "../provided.h"
+#include "../MapSnapshot.h"
+#include "../QueryLog.h"
+#include "../LatencyHistogram.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <list>
+#include <random>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+using namespace std;
+
+//routes may take different but equally short ways, so their sums can differ in the last bits
+const double DISTANCE_TOLERANCE = 1e-7;
+//how many differences are described in full before only being counted
+const int MAX_REPORTED = 20;
+
+const char* resultName(DeliveryResult result)
+{
+	switch (result)
+	{
+	case DELIVERY_SUCCESS: return "DELIVERY_SUCCESS";
+	case NO_ROUTE: return "NO_ROUTE";
+	case BAD_COORD: return "BAD_COORD";
+	case CANCELLED: return "CANCELLED";
+	}
+	return "unknown";
+}
+
+//what one replay thread saw
+struct ReplayTally
+{
+	LatencyHistogram routeLatencies;
+	LatencyHistogram planLatencies;
+	vector<string> differences;
+	long long resultDifferences = 0;
+	long long distanceDifferences = 0;
+	long long planDistanceChanges = 0;
+	double largestPlanChange = 0;
+};
+
+void replayOne(const LoggedQuery& query, int index, const PointToPointRouter& router, const DeliveryPlanner& planner,
+	ReplayTally& tally, double& latency, chrono::steady_clock::time_point due)
+{
+	DeliveryResult result;
+	double distance = 0;
+	if (query.call == LOGGED_ROUTE)
+	{
+		list<StreetSegment> route;
+		RouteSearchStats stats;
+		result = router.generatePointToPointRoute(query.start, query.end, query.maxSuboptimality, route, distance, stats);
+	}
+	else
+	{
+		vector<DeliveryCommand> commands;
+		result = planner.generateDeliveryPlan(query.start, query.deliveries, commands, distance);
+	}
+	latency = chrono::duration<double, micro>(chrono::steady_clock::now() - due).count();
+
+	const char* call = query.call == LOGGED_ROUTE ? "route" : "plan";
+	if (result != query.result)
+	{
+		tally.resultDifferences++;
+		tally.differences.push_back("query " + to_string(index) + " (" + call + "): logged " + resultName(query.result)
+			+ ", replayed " + resultName(result));
+		return;
+	}
+	double change = fabs(distance - query.distance);
+	if (query.call == LOGGED_PLAN)
+	{
+		if (change > DISTANCE_TOLERANCE * max(1.0, query.distance))
+		{
+			tally.planDistanceChanges++;
+			tally.largestPlanChange = max(tally.largestPlanChange, change / max(query.distance, DISTANCE_TOLERANCE));
+		}
+	}
+	else if (change > DISTANCE_TOLERANCE * max(1.0, query.distance))
+	{
+		tally.distanceDifferences++;
+		tally.differences.push_back("query " + to_string(index) + " (route): logged " + to_string(query.distance)
+			+ " miles, replayed " + to_string(distance));
+	}
+}
+
+int replay(const string& mapFile, const string& logFile, int numThreads, bool paced)
+{
+	StreetMap sm;
+	if (!sm.load(mapFile))
+	{
+		cout << "Unable to load map data file " << mapFile << endl;
+		return 1;
+	}
+	vector<LoggedQuery> queries;
+	if (!QueryLog::read(logFile, queries))
+	{
+		cout << "Unable to read query log " << logFile << endl;
+		return 1;
+	}
+	LatencyHistogram loggedRoutes;
+	LatencyHistogram loggedPlans;
+	for (int i = 0; i < queries.size(); i++)
+		(queries[i].call == LOGGED_ROUTE ? loggedRoutes : loggedPlans).record(queries[i].latency);
+
+	PointToPointRouter router(&sm);
+	DeliveryPlanner planner(&sm);
+	numThreads = max(1, numThreads);
+	vector<ReplayTally> tallies(numThreads);
+	atomic<int> next(0);
+	chrono::steady_clock::time_point replayStarted = chrono::steady_clock::now();
+	auto worker = [&](int t)
+	{
+		for (int i = next++; i < queries.size(); i = next++)
+		{
+			chrono::steady_clock::time_point due = chrono::steady_clock::now();
+			if (paced)
+			{
+				due = replayStarted + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double, micro>(queries[i].startedAt));
+				this_thread::sleep_until(due);
+			}
+			double latency = 0;
+			replayOne(queries[i], i, router, planner, tallies[t], latency, due);
+			(queries[i].call == LOGGED_ROUTE ? tallies[t].routeLatencies : tallies[t].planLatencies).record(latency);
+		}
+	};
+	vector<thread> threads;
+	for (int t = 0; t < numThreads; t++)
+		threads.push_back(thread(worker, t));
+	for (int t = 0; t < numThreads; t++)
+		threads[t].join();
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - replayStarted).count();
+
+	ReplayTally total;
+	for (int t = 0; t < numThreads; t++)
+	{
+		total.routeLatencies.merge(tallies[t].routeLatencies);
+		total.planLatencies.merge(tallies[t].planLatencies);
+		total.differences.insert(total.differences.end(), tallies[t].differences.begin(), tallies[t].differences.end());
+		total.resultDifferences += tallies[t].resultDifferences;
+		total.distanceDifferences += tallies[t].distanceDifferences;
+		total.planDistanceChanges += tallies[t].planDistanceChanges;
+		total.largestPlanChange = max(total.largestPlanChange, tallies[t].largestPlanChange);
+	}
+
+	cout.setf(ios::fixed);
+	cout.precision(1);
+	cout << queries.size() << " queries on " << numThreads << " threads, " << (paced ? "paced" : "flat out") << ": "
+		<< seconds << " s, " << queries.size() / max(seconds, 1e-9) << " queries/s" << endl;
+	cout << "routes logged    " << loggedRoutes.summary() << endl;
+	cout << "routes replayed  " << total.routeLatencies.summary() << endl;
+	cout << "plans logged     " << loggedPlans.summary() << endl;
+	cout << "plans replayed   " << total.planLatencies.summary() << endl;
+	for (int i = 0; i < total.differences.size() && i < MAX_REPORTED; i++)
+		cout << total.differences[i] << endl;
+	cout << total.resultDifferences << " result differences, " << total.distanceDifferences << " route distance differences, "
+		<< total.planDistanceChanges << " plan distances changed (largest by " << 100 * total.largestPlanChange << "%)" << endl;
+	return total.resultDifferences == 0 && total.distanceDifferences == 0 ? 0 : 1;
+}
+
+//random routes and plans made through the public classes, once without a log and once
+//recording into logFile, to produce a log to replay and show what recording costs
+int record(const string& mapFile, const string& logFile, int numRoutes, int numPlans)
+{
+	StreetMap sm;
+	if (!sm.load(mapFile))
+	{
+		cout << "Unable to load map data file " << mapFile << endl;
+		return 1;
+	}
+	const StreetGraph& graph = *sm.getSnapshot()->graph;
+	if (graph.nodeCount() < 2)
+	{
+		cout << "Not enough of " << mapFile << " to make queries on" << endl;
+		return 1;
+	}
+	vector<GeoCoord> coords;
+	for (int i = 0; i < graph.nodeCount(); i++)
+		coords.push_back(graph.coord(i));
+
+	mt19937 generator(5);
+	uniform_int_distribution<int> pick(0, coords.size() - 1);
+	vector<pair<GeoCoord, GeoCoord>> routes;
+	for (int i = 0; i < numRoutes; i++)
+		routes.push_back(make_pair(coords[pick(generator)], coords[pick(generator)]));
+	//plans mostly stay where the depot can reach, as real ones do
+	GeoCoord depot = coords[pick(generator)];
+	vector<GeoCoord> reachable;
+	for (int i = 0; i < graph.nodeCount(); i++)
+		if (graph.component(i) == graph.component(graph.findNode(depot)))
+			reachable.push_back(coords[i]);
+	uniform_int_distribution<int> pickReachable(0, reachable.size() - 1);
+	vector<vector<DeliveryRequest>> plans(numPlans);
+	for (int p = 0; p < numPlans; p++)
+		for (int i = 0; i < 10; i++)
+			plans[p].push_back(DeliveryRequest("item " + to_string(i), reachable[pickReachable(generator)]));
+
+	PointToPointRouter router(&sm);
+	DeliveryPlanner planner(&sm);
+	auto run = [&]()
+	{
+		chrono::steady_clock::time_point started = chrono::steady_clock::now();
+		list<StreetSegment> route;
+		vector<DeliveryCommand> commands;
+		double distance = 0;
+		for (int i = 0; i < routes.size(); i++)
+			router.generatePointToPointRoute(routes[i].first, routes[i].second, route, distance);
+		for (int p = 0; p < plans.size(); p++)
+			planner.generateDeliveryPlan(depot, plans[p], commands, distance);
+		return chrono::duration<double, micro>(chrono::steady_clock::now() - started).count();
+	};
+	double plainMicros = run();
+	QueryLog log;
+	if (!log.open(logFile))
+	{
+		cout << "Unable to write query log " << logFile << endl;
+		return 1;
+	}
+	QueryLog::setActive(&log);
+	double recordedMicros = run();
+	QueryLog::setActive(nullptr);
+	log.close();
+
+	int calls = max(1, numRoutes + numPlans);
+	cout.setf(ios::fixed);
+	cout.precision(2);
+	cout << calls << " calls recorded in " << logFile << ": " << plainMicros / calls << " us/call without a log, "
+		<< recordedMicros / calls << " us/call recording" << endl;
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc >= 4 && strcmp(argv[1], "record") == 0)
+		return record(argv[2], argv[3], argc >= 5 ? atoi(argv[4]) : 2000, argc >= 6 ? atoi(argv[5]) : 50);
+	if (argc >= 3 && argc <= 5)
+		return replay(argv[1], argv[2], argc >= 4 ? atoi(argv[3]) : 1, argc >= 5 && strcmp(argv[4], "paced") == 0);
+
+	cout << "Usage: " << argv[0] << " mapdata.txt queries.log [threads] [paced]" << endl;
+	cout << "       " << argv[0] << " record mapdata.txt queries.log [routes] [plans]" << endl;
+	return 1;
+}
@@ -0,0 +1,668 @@
+// RouterCheck.cpp
+
+// Differential check of every routing backend against a plain Dijkstra search.  Each
+// (start, end) pair is routed by every backend; results must agree with the reference,
+// distances must match within a small tolerance (or within the bound, for weighted A*, or
+// the length rounding, for the compressed graph),
+// and every route must be a chain of real map segments from start to end whose lengths
+// add up to the reported distance.  Latency is recorded per backend.  A few planning
+// cases that depend on routes failing, such as a stop behind a closed road, are checked too.
+//
+// Build from the repository root with
+//     g++ -std=c++17 -O2 -pthread -o routercheck tools/RouterCheck.cpp $(ls *.cpp | grep -v main.cpp)
+// and run
+//     routercheck mapdata.txt [queries] [seed]      check random and adversarial pairs
+//     routercheck generate map.txt rows cols seed   write a synthetic grid map to check
+//     routercheck replay map.txt input...           rerun fuzzer inputs against a map
+//
+// Built with
+//     clang++ -std=c++17 -O1 -g -fsanitize=fuzzer,address -DROUTERCHECK_FUZZ -o fuzz tools/RouterCheck.cpp $(ls *.cpp | grep -v main.cpp)
+// it is a libFuzzer target instead: every input is decoded into a list of queries on a
+// generated map, and any disagreement aborts.
+
+#include "../provided.h"
+#include "../MapSnapshot.h"
+#include "../RouteSearch.h"
+#include "../HubOracle.h"
+#include "../TiledMap.h"
+#include "../CompressedGraph.h"
+#include "../IncrementalPlan.h"
+#include "../LatencyHistogram.h"
+#include "../Parallel.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <list>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <random>
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+using namespace std;
+
+//routes may take different but equally short ways, so their sums can differ in the last bits
+const double DISTANCE_TOLERANCE = 1e-7;
+//the bound the weighted A* backend is run with
+const double WEIGHTED_BOUND = 1.5;
+//how many mismatches are described in full before only being counted
+const int MAX_REPORTED = 20;
+
+struct Query
+{
+	GeoCoord start;
+	GeoCoord end;
+	string kind;
+};
+
+//one way of answering a route query
+class Backend
+{
+public:
+	Backend(string name, double bound, double lengthUnit = 0) : m_name(name), m_bound(bound), m_lengthUnit(lengthUnit) {}
+	virtual ~Backend() {}
+	virtual DeliveryResult route(const GeoCoord& start, const GeoCoord& end, list<StreetSegment>& route, double& distance) const = 0;
+	const string& name() const { return m_name; }
+	  // how much longer than the shortest its routes may be
+	double bound() const { return m_bound; }
+	  // the unit edge lengths are rounded up to before searching, so its routes may also be
+	  // this much longer for every edge of the shortest route
+	double lengthUnit() const { return m_lengthUnit; }
+private:
+	string m_name;
+	double m_bound;
+	double m_lengthUnit;
+};
+
+class RouterBackend : public Backend
+{
+public:
+	RouterBackend(string name, const PointToPointRouter* router, double weight = 1, double lengthUnit = 0)
+		: Backend(name, weight, lengthUnit), m_router(router), m_weight(weight) {}
+	DeliveryResult route(const GeoCoord& start, const GeoCoord& end, list<StreetSegment>& route, double& distance) const
+	{
+		RouteSearchStats stats;
+		if (m_weight == 1)
+			return m_router->generatePointToPointRoute(start, end, route, distance);
+		return m_router->generatePointToPointRoute(start, end, m_weight, route, distance, stats);
+	}
+private:
+	const PointToPointRouter* m_router;
+	double m_weight;
+};
+
+//searchRoute on a snapshot, which may carry hub trees
+class SnapshotBackend : public Backend
+{
+public:
+	SnapshotBackend(string name, shared_ptr<const MapSnapshot> map) : Backend(name, 1), m_map(map) {}
+	DeliveryResult route(const GeoCoord& start, const GeoCoord& end, list<StreetSegment>& route, double& distance) const
+	{
+		route.clear();
+		distance = 0;
+		const StreetGraph& graph = *m_map->graph;
+		int startNode = graph.findNode(start);
+		int endNode = graph.findNode(end);
+		if (startNode == -1 || endNode == -1)
+			return BAD_COORD;
+		pmr::monotonic_buffer_resource arena;
+		RouteScratch scratch(graph, &arena);
+		EdgeRoute edges(&arena);
+		DeliveryResult result = searchRoute(*m_map, startNode, endNode, edges, distance, scratch);
+		if (result == DELIVERY_SUCCESS)
+			appendSegments(graph, edges, route);
+		return result;
+	}
+private:
+	shared_ptr<const MapSnapshot> m_map;
+};
+
+//textbook Dijkstra, sharing no code with the backends, as the answer they are held to
+class ReferenceRouter
+{
+public:
+	ReferenceRouter(const StreetGraph& graph) : m_graph(graph) {}
+	  // edges is how many edges the shortest route has
+	DeliveryResult route(const GeoCoord& start, const GeoCoord& end, double& distance, int& edges)
+	{
+		distance = 0;
+		edges = 0;
+		int startNode = m_graph.findNode(start);
+		int endNode = m_graph.findNode(end);
+		if (startNode == -1 || endNode == -1)
+			return BAD_COORD;
+		m_distances.assign(m_graph.nodeCount(), HUGE_VAL);
+		m_edges.assign(m_graph.nodeCount(), 0);
+		m_distances[startNode] = 0;
+		priority_queue<pair<double, int>, vector<pair<double, int>>, greater<pair<double, int>>> open;
+		open.push(make_pair(0.0, startNode));
+		while (!open.empty())
+		{
+			pair<double, int> top = open.top();
+			open.pop();
+			if (top.first > m_distances[top.second])
+				continue;
+			if (top.second == endNode)
+			{
+				distance = top.first;
+				edges = m_edges[endNode];
+				return DELIVERY_SUCCESS;
+			}
+			for (int e = m_graph.firstEdge(top.second); e < m_graph.firstEdge(top.second + 1); e++)
+			{
+				double d = top.first + m_graph.edgeLength(e);
+				if (d < m_distances[m_graph.edgeTarget(e)])
+				{
+					m_distances[m_graph.edgeTarget(e)] = d;
+					m_edges[m_graph.edgeTarget(e)] = m_edges[top.second] + 1;
+					open.push(make_pair(d, m_graph.edgeTarget(e)));
+				}
+			}
+		}
+		return NO_ROUTE;
+	}
+private:
+	const StreetGraph& m_graph;
+	vector<double> m_distances;
+	vector<int> m_edges;
+};
+
+//every backend over one map, plus what is needed to make queries for it
+class Harness
+{
+public:
+	bool setUp(const string& mapFile);
+	  // pick a query of the given kind (any value; it is taken modulo the number of kinds)
+	  // from two random numbers
+	Query makeQuery(unsigned int kind, unsigned int a, unsigned int b) const;
+	  // route q with every backend and check the answers; returns the number of failures
+	int check(const Query& q, ReferenceRouter& reference, vector<LatencyHistogram>& latencies, vector<string>& failures) const;
+	int backendCount() const { return m_backends.size(); }
+	const Backend& backend(int i) const { return *m_backends[i]; }
+	const StreetGraph& graph() const { return *m_reference; }
+	~Harness();
+
+private:
+	//one per node order, and one more carrying hub trees
+	StreetMap m_maps[4];
+	vector<unique_ptr<PointToPointRouter>> m_routers;
+	TiledMap m_tiles;
+	CompressedGraph m_compressed;
+	string m_tileFile;
+	string m_hubFile;
+	vector<unique_ptr<Backend>> m_backends;
+	shared_ptr<const StreetGraph> m_reference;
+	vector<int> m_hubs;
+	//nodes at the edges of the map, dead ends and the busiest junctions
+	vector<int> m_extremes;
+
+	bool isOnMap(const StreetSegment& seg) const;
+};
+
+Harness::~Harness()
+{
+	if (!m_tileFile.empty())
+		remove(m_tileFile.c_str());
+	if (!m_hubFile.empty())
+		remove(m_hubFile.c_str());
+}
+
+bool Harness::setUp(const string& mapFile)
+{
+	const NodeOrder orders[] = { LOAD_ORDER, HILBERT_ORDER, CUTHILL_MCKEE_ORDER };
+	const char* orderNames[] = { "a*/load", "a*/hilbert", "a*/cuthill-mckee" };
+	for (int i = 0; i < 3; i++)
+	{
+		if (!m_maps[i].load(mapFile, orders[i]))
+			return false;
+		m_routers.push_back(unique_ptr<PointToPointRouter>(new PointToPointRouter(&m_maps[i])));
+		m_backends.push_back(unique_ptr<Backend>(new RouterBackend(orderNames[i], m_routers.back().get())));
+	}
+	m_reference = m_maps[0].getSnapshot()->graph;
+	const StreetGraph& hilbert = *m_maps[1].getSnapshot()->graph;
+	if (hilbert.nodeCount() == 0)
+		return false;
+
+	m_backends.push_back(unique_ptr<Backend>(new RouterBackend("weighted a*", m_routers[1].get(), WEIGHTED_BOUND)));
+
+	//hub trees from a few nodes spread over the map, written out and read back the way
+	//a real deployment would use them
+	vector<GeoCoord> hubCoords;
+	for (int i = 0; i < 4; i++)
+	{
+		int node = (long long)hilbert.nodeCount() * i / 4;
+		hubCoords.push_back(hilbert.coord(node));
+		m_hubs.push_back(m_reference->findNode(hilbert.coord(node)));
+	}
+	string scratchBase = mapFile + "." + to_string((long long)chrono::steady_clock::now().time_since_epoch().count());
+	HubOracle oracle;
+	m_hubFile = scratchBase + ".hubs";
+	if (!oracle.build(hilbert, hubCoords) || !oracle.save(m_hubFile) || !m_maps[3].load(mapFile, HILBERT_ORDER)
+		|| !m_maps[3].loadHubs(m_hubFile))
+		return false;
+	m_backends.push_back(unique_ptr<Backend>(new SnapshotBackend("hub trees", m_maps[3].getSnapshot())));
+
+	m_tileFile = scratchBase + ".tiles";
+	if (!TiledMap::write(hilbert, 256, m_tileFile) || !m_tiles.open(m_tileFile, 4))
+		return false;
+	m_routers.push_back(unique_ptr<PointToPointRouter>(new PointToPointRouter(&m_tiles)));
+	m_backends.push_back(unique_ptr<Backend>(new RouterBackend("tiled", m_routers.back().get())));
+
+	if (!m_compressed.build(hilbert))
+		return false;
+	m_routers.push_back(unique_ptr<PointToPointRouter>(new PointToPointRouter(&m_compressed)));
+	m_backends.push_back(unique_ptr<Backend>(new RouterBackend("compressed", m_routers.back().get(), 1,
+		CompressedGraph::LENGTH_UNIT)));
+
+	const StreetGraph& graph = *m_reference;
+	int corners[4] = { 0, 0, 0, 0 };
+	int busiest = 0;
+	for (int n = 0; n < graph.nodeCount(); n++)
+	{
+		if (graph.latitude(n) < graph.latitude(corners[0]))
+			corners[0] = n;
+		if (graph.latitude(n) > graph.latitude(corners[1]))
+			corners[1] = n;
+		if (graph.longitude(n) < graph.longitude(corners[2]))
+			corners[2] = n;
+		if (graph.longitude(n) > graph.longitude(corners[3]))
+			corners[3] = n;
+		int degree = graph.firstEdge(n + 1) - graph.firstEdge(n);
+		if (degree > graph.firstEdge(busiest + 1) - graph.firstEdge(busiest))
+			busiest = n;
+		if (degree == 2 && m_extremes.size() < 64)	//a dead end: one segment, both directions
+			m_extremes.push_back(n);
+	}
+	m_extremes.insert(m_extremes.end(), corners, corners + 4);
+	m_extremes.push_back(busiest);
+	return true;
+}
+
+Query Harness::makeQuery(unsigned int kind, unsigned int a, unsigned int b) const
+{
+	const StreetGraph& graph = *m_reference;
+	int numNodes = graph.nodeCount();
+	Query q;
+	switch (kind % 7)
+	{
+	case 0:
+		q.kind = "random";
+		q.start = graph.coord(a % numNodes);
+		q.end = graph.coord(b % numNodes);
+		break;
+	case 1:
+		q.kind = "same node";
+		q.start = graph.coord(a % numNodes);
+		q.end = q.start;
+		break;
+	case 2:
+	{
+		//a coord just off a real one, which no backend may snap to the map, or one far
+		//outside the map, which the tiled map must still look up without finding
+		q.kind = "off map";
+		const GeoCoord& real = graph.coord(a % numNodes);
+		GeoCoord off(real.latitudeText + (b % 2 == 0 ? "1" : "9"), real.longitudeText);
+		if (b % 3 == 0)
+			off = b % 2 == 0 ? GeoCoord("89.9999999", "-179.9999999") : GeoCoord("-89.9999999", "179.9999999");
+		q.start = b % 4 < 2 ? off : graph.coord(b % numNodes);
+		q.end = b % 4 < 2 ? graph.coord(b % numNodes) : off;
+		break;
+	}
+	case 3:
+		q.kind = "extremes";
+		q.start = graph.coord(m_extremes[a % m_extremes.size()]);
+		q.end = graph.coord(m_extremes[b % m_extremes.size()]);
+		break;
+	case 4:
+		q.kind = "hub";
+		q.start = graph.coord(m_hubs[a % m_hubs.size()]);
+		q.end = graph.coord(b % numNodes);
+		if (b % 2 == 1)
+			swap(q.start, q.end);
+		break;
+	case 5:
+	{
+		//close together along the Hilbert curve, so in the same or the next tile
+		q.kind = "neighbourhood";
+		const StreetGraph& hilbert = *m_maps[1].getSnapshot()->graph;
+		int start = a % numNodes;
+		int end = min(numNodes - 1, max(0, start + (int)(b % 101) - 50));
+		q.start = hilbert.coord(start);
+		q.end = hilbert.coord(end);
+		break;
+	}
+	default:
+	{
+		//the two ends of one segment, which may be a dead end or a self loop
+		q.kind = "one segment";
+		int node = a % numNodes;
+		int degree = graph.firstEdge(node + 1) - graph.firstEdge(node);
+		q.start = graph.coord(node);
+		q.end = degree == 0 ? q.start : graph.coord(graph.edgeTarget(graph.firstEdge(node) + b % degree));
+		break;
+	}
+	}
+	return q;
+}
+
+bool Harness::isOnMap(const StreetSegment& seg) const
+{
+	const StreetGraph& graph = *m_reference;
+	int node = graph.findNode(seg.start);
+	if (node == -1)
+		return false;
+	for (int e = graph.firstEdge(node); e < graph.firstEdge(node + 1); e++)
+		if (graph.coord(graph.edgeTarget(e)) == seg.end && graph.edgeName(e) == seg.name)
+			return true;
+	return false;
+}
+
+int Harness::check(const Query& q, ReferenceRouter& reference, vector<LatencyHistogram>& latencies, vector<string>& failures) const
+{
+	double expected = 0;
+	int expectedEdges = 0;
+	DeliveryResult expectedResult = reference.route(q.start, q.end, expected, expectedEdges);
+	int failed = 0;
+	for (int b = 0; b < m_backends.size(); b++)
+	{
+		const Backend& backend = *m_backends[b];
+		list<StreetSegment> route;
+		double distance = 0;
+		auto start = chrono::steady_clock::now();
+		DeliveryResult result = backend.route(q.start, q.end, route, distance);
+		latencies[b].record(chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+
+		string problem;
+		double tolerance = DISTANCE_TOLERANCE * (1 + expected);
+		if (result != expectedResult)
+			problem = "result " + to_string(result) + ", expected " + to_string(expectedResult);
+		else if (result == DELIVERY_SUCCESS && (distance < expected - tolerance
+			|| distance > expected * backend.bound() + backend.lengthUnit() * expectedEdges + tolerance))
+			problem = "distance " + to_string(distance) + ", expected " + to_string(expected);
+		else if (result == DELIVERY_SUCCESS && q.start == q.end && !route.empty())
+			problem = "nonempty route to the same place";
+		else if (result == DELIVERY_SUCCESS && !(q.start == q.end))
+		{
+			double length = 0;
+			GeoCoord at = q.start;
+			for (list<StreetSegment>::const_iterator it = route.begin(); it != route.end() && problem.empty(); it++)
+			{
+				if (!(it->start == at))
+					problem = "route breaks at " + it->start.latitudeText + " " + it->start.longitudeText;
+				else if (!isOnMap(*it))
+					problem = "segment on " + it->name + " is not on the map";
+				length += distanceEarthMiles(it->start, it->end);
+				at = it->end;
+			}
+			if (problem.empty() && !(at == q.end))
+				problem = "route ends at " + at.latitudeText + " " + at.longitudeText;
+			if (problem.empty() && fabs(length - distance) > tolerance)
+				problem = "segments add up to " + to_string(length) + ", reported " + to_string(distance);
+		}
+		if (!problem.empty())
+		{
+			failed++;
+			failures.push_back(backend.name() + " on " + q.kind + " query " + q.start.latitudeText + " " + q.start.longitudeText
+				+ " -> " + q.end.latitudeText + " " + q.end.longitudeText + ": " + problem);
+		}
+	}
+	return failed;
+}
+
+//a plan whose only stop is behind a closed road can't be started, and editing it then
+//must fail cleanly rather than patch legs that were never routed; returns the number of failures
+int checkClosedRoadPlan(const string& mapFile, vector<string>& failures)
+{
+	StreetMap sm;
+	if (!sm.load(mapFile))
+		return 0;
+	shared_ptr<const MapSnapshot> map = sm.getSnapshot();
+	const StreetGraph& graph = *map->graph;
+	int cutOff = -1;
+	for (int n = 0; n < graph.nodeCount() && cutOff == -1; n++)
+		for (int e = graph.firstEdge(n); e < graph.firstEdge(n + 1); e++)
+			if (graph.edgeTarget(e) != n)
+				cutOff = n;
+	if (cutOff == -1)
+		return 0;
+	//closing every road at a node leaves it in its component, so only routing finds it cut off
+	GeoCoord stop = graph.coord(cutOff);
+	GeoCoord depot;
+	vector<EdgeWeightUpdate> closure;
+	for (int e = graph.firstEdge(cutOff); e < graph.firstEdge(cutOff + 1); e++)
+	{
+		if (graph.edgeTarget(e) != cutOff)
+			depot = graph.coord(graph.edgeTarget(e));
+		closure.push_back(EdgeWeightUpdate(StreetSegment(stop, graph.coord(graph.edgeTarget(e)), graph.edgeName(e)), 1, true));
+	}
+	sm.applyEdgeWeights(closure);
+
+	IncrementalPlan plan(&sm);
+	vector<DeliveryRequest> deliveries;
+	deliveries.push_back(DeliveryRequest("parcel", stop));
+	PlanEdit edit;
+	int failed = 0;
+	DeliveryResult started = plan.start(depot, deliveries);
+	if (started != NO_ROUTE)
+	{
+		failed++;
+		failures.push_back("plan across a closed road started with result " + to_string(started) + ", expected " + to_string(NO_ROUTE));
+	}
+	DeliveryResult inserted = plan.insertStop(DeliveryRequest("parcel", depot), edit);
+	if (inserted != BAD_COORD || !plan.deliveries().empty())
+	{
+		failed++;
+		failures.push_back("stop added to a plan that failed to start, result " + to_string(inserted));
+	}
+	return failed;
+}
+
+//run numQueries queries of every kind over the map, spread over the machine's cores
+int runChecks(const string& mapFile, long long numQueries, unsigned int seed)
+{
+	Harness harness;
+	if (!harness.setUp(mapFile))
+	{
+		cout << "Unable to set up the backends for " << mapFile << endl;
+		return 1;
+	}
+
+	const int CHUNK = 256;
+	int numChunks = (numQueries + CHUNK - 1) / CHUNK;
+	vector<LatencyHistogram> latencies(harness.backendCount());
+	vector<string> failures;
+	long long failed = 0;
+	mutex resultsMutex;
+	auto start = chrono::steady_clock::now();
+	parallelFor(numChunks, [&](int chunk)
+	{
+		mt19937 generator(seed + chunk);
+		ReferenceRouter reference(harness.graph());
+		vector<LatencyHistogram> chunkLatencies(harness.backendCount());
+		vector<string> chunkFailures;
+		int chunkFailed = 0;
+		long long last = min(numQueries, (long long)(chunk + 1) * CHUNK);
+		for (long long i = (long long)chunk * CHUNK; i < last; i++)
+			chunkFailed += harness.check(harness.makeQuery(i, generator(), generator()), reference, chunkLatencies, chunkFailures);
+
+		lock_guard<mutex> lock(resultsMutex);
+		for (int b = 0; b < harness.backendCount(); b++)
+			latencies[b].merge(chunkLatencies[b]);
+		for (int i = 0; i < chunkFailures.size() && failures.size() < MAX_REPORTED; i++)
+			failures.push_back(chunkFailures[i]);
+		failed += chunkFailed;
+	});
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	failed += checkClosedRoadPlan(mapFile, failures);
+
+	for (int i = 0; i < failures.size(); i++)
+		cout << "FAIL " << failures[i] << endl;
+	for (int b = 0; b < harness.backendCount(); b++)
+		cout << harness.backend(b).name() << ": " << latencies[b].summary() << endl;
+	cout << numQueries << " queries against " << harness.backendCount() << " backends in " << seconds << " s, "
+		<< failed << " failures" << endl;
+	return failed == 0 ? 0 : 1;
+}
+
+//a grid of streets with gaps, a few diagonals, doubled segments, self loops and a
+//separate island, so every oddity the backends must agree on turns up
+bool generateMap(const string& mapFile, int rows, int cols, unsigned int seed)
+{
+	ofstream outf(mapFile);
+	if (!outf || rows < 2 || cols < 2)
+		return false;
+	mt19937 generator(seed);
+	uniform_real_distribution<double> chance(0, 1);
+	auto coordText = [](int row, int col, int island)
+	{
+		ostringstream oss;
+		oss.setf(ios::fixed);
+		oss.precision(7);
+		oss << 34.0 + 0.001 * row + 0.05 * island << " " << -118.4 + 0.0012 * col;
+		return oss.str();
+	};
+	auto street = [&outf](const string& name, const vector<string>& segments)
+	{
+		if (segments.empty())
+			return;
+		outf << name << "\n" << segments.size() << "\n";
+		for (int i = 0; i < segments.size(); i++)
+			outf << segments[i] << "\n";
+	};
+	for (int island = 0; island < 2; island++)
+	{
+		int islandRows = island == 0 ? rows : 2;
+		int islandCols = island == 0 ? cols : 3;
+		for (int r = 0; r < islandRows; r++)
+		{
+			vector<string> segments;
+			for (int c = 0; c + 1 < islandCols; c++)
+				if (chance(generator) < 0.85)
+					segments.push_back(coordText(r, c, island) + " " + coordText(r, c + 1, island));
+			street("Row " + to_string(island) + "-" + to_string(r), segments);
+		}
+		for (int c = 0; c < islandCols; c++)
+		{
+			vector<string> segments;
+			for (int r = 0; r + 1 < islandRows; r++)
+				if (chance(generator) < 0.85)
+					segments.push_back(coordText(r, c, island) + " " + coordText(r + 1, c, island));
+			street("Column " + to_string(island) + "-" + to_string(c), segments);
+		}
+	}
+	vector<string> diagonals;
+	vector<string> doubled;
+	vector<string> loops;
+	for (int i = 0; i < rows * cols / 20 + 1; i++)
+	{
+		int r = generator() % (rows - 1);
+		int c = generator() % (cols - 1);
+		diagonals.push_back(coordText(r, c, 0) + " " + coordText(r + 1, c + 1, 0));
+		if (i % 3 == 0)
+			doubled.push_back(coordText(r, c, 0) + " " + coordText(r, c + 1, 0));
+		if (i % 5 == 0)
+			loops.push_back(coordText(r, c, 0) + " " + coordText(r, c, 0));
+	}
+	street("Diagonal Way", diagonals);
+	street("Frontage Road", doubled);
+	street("Cul De Sac", loops);
+	return bool(outf);
+}
+
+//the harness a fuzzer input is run against, set up on first use and torn down at exit
+Harness& fuzzHarness(const string& mapFile)
+{
+	static Harness harness;
+	static bool ready = false;
+	if (!ready)
+	{
+		if (!harness.setUp(mapFile))
+		{
+			cerr << "Unable to set up the backends for " << mapFile << endl;
+			abort();
+		}
+		ready = true;
+	}
+	return harness;
+}
+
+//every nine bytes of input are one query: a kind and two four byte numbers
+int runFuzzInput(Harness& harness, const uint8_t* data, size_t size)
+{
+	ReferenceRouter reference(harness.graph());
+	vector<LatencyHistogram> latencies(harness.backendCount());
+	vector<string> failures;
+	int failed = 0;
+	for (size_t i = 0; i + 9 <= size; i += 9)
+	{
+		uint32_t a = 0;
+		uint32_t b = 0;
+		memcpy(&a, data + i + 1, 4);
+		memcpy(&b, data + i + 5, 4);
+		failed += harness.check(harness.makeQuery(data[i], a, b), reference, latencies, failures);
+	}
+	for (int i = 0; i < failures.size(); i++)
+		cerr << "FAIL " << failures[i] << endl;
+	return failed;
+}
+
+#ifdef ROUTERCHECK_FUZZ
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+	static string mapFile;
+	if (mapFile.empty())
+	{
+		mapFile = "routercheck-fuzz-map.txt";
+		if (!generateMap(mapFile, 12, 12, 1))
+			abort();
+	}
+	if (runFuzzInput(fuzzHarness(mapFile), data, size) != 0)
+		abort();
+	return 0;
+}
+
+#else
+
+int main(int argc, char *argv[])
+{
+	if (argc == 6 && strcmp(argv[1], "generate") == 0)
+	{
+		if (!generateMap(argv[2], atoi(argv[3]), atoi(argv[4]), atoi(argv[5])))
+		{
+			cout << "Unable to write " << argv[2] << endl;
+			return 1;
+		}
+		return 0;
+	}
+	if (argc >= 4 && strcmp(argv[1], "replay") == 0)
+	{
+		int failed = 0;
+		for (int i = 3; i < argc; i++)
+		{
+			ifstream inf(argv[i], ios::binary);
+			string bytes((istreambuf_iterator<char>(inf)), istreambuf_iterator<char>());
+			failed += runFuzzInput(fuzzHarness(argv[2]), reinterpret_cast<const uint8_t*>(bytes.data()), bytes.size());
+		}
+		cout << failed << " failures" << endl;
+		return failed == 0 ? 0 : 1;
+	}
+	if (argc >= 2 && argc <= 4)
+		return runChecks(argv[1], argc >= 3 ? atoll(argv[2]) : 10000, argc >= 4 ? atoi(argv[3]) : 1);
+
+	cout << "Usage: " << argv[0] << " mapdata.txt [queries] [seed]" << endl;
+	cout << "       " << argv[0] << " generate map.txt rows cols seed" << endl;
+	cout << "       " << argv[0] << " replay map.txt input..." << endl;
+	return 1;
+}
+
+#endif